@@ -0,0 +1,65 @@
+//
+// Created by 杨丰硕 on 2023/3/12.
+//
+#include <cassert>
+#include <cstdint>
+#include "Arena.h"
+
+using namespace kvstore;
+
+Arena::Arena() = default;
+
+Arena::~Arena() {
+    for (auto slab : slabs_) {
+        delete[] slab;
+    }
+}
+
+char *Arena::Allocate(size_t bytes) {
+    assert(bytes > 0);
+    if (bytes <= alloc_bytes_remaining_) {
+        char *result = alloc_ptr_;
+        alloc_ptr_ += bytes;
+        alloc_bytes_remaining_ -= bytes;
+        return result;
+    }
+    return AllocateFallback(bytes);
+}
+
+char *Arena::AllocateAligned(size_t bytes) {
+    constexpr size_t align = alignof(std::max_align_t);
+    static_assert((align & (align - 1)) == 0, "alignment should be a power of 2");
+    size_t mod = reinterpret_cast<uintptr_t>(alloc_ptr_) & (align - 1);
+    size_t slop = (mod == 0 ? 0 : align - mod);
+    size_t needed = bytes + slop;
+    char *result;
+    if (needed <= alloc_bytes_remaining_) {
+        result = alloc_ptr_ + slop;
+        alloc_ptr_ += needed;
+        alloc_bytes_remaining_ -= needed;
+    } else {
+        result = AllocateFallback(bytes);      // new[]返回的地址本身就是对齐的
+    }
+    assert((reinterpret_cast<uintptr_t>(result) & (align - 1)) == 0);
+    return result;
+}
+
+char *Arena::AllocateFallback(size_t bytes) {
+    if (bytes > kSlabSize / 4) {       // 大对象单独分配,避免浪费当前slab剩余的空间
+        return AllocateNewSlab(bytes);
+    }
+    alloc_ptr_ = AllocateNewSlab(kSlabSize);
+    alloc_bytes_remaining_ = kSlabSize;
+
+    char *result = alloc_ptr_;
+    alloc_ptr_ += bytes;
+    alloc_bytes_remaining_ -= bytes;
+    return result;
+}
+
+char *Arena::AllocateNewSlab(size_t slab_bytes) {
+    char *result = new char[slab_bytes];
+    slabs_.push_back(result);
+    memory_usage_.fetch_add(slab_bytes + sizeof(char*), std::memory_order_relaxed);
+    return result;
+}
@@ -0,0 +1,49 @@
+//
+// Created by 杨丰硕 on 2023/3/12.
+//
+
+#ifndef KVSTORE_ARENA_H
+#define KVSTORE_ARENA_H
+
+#include <atomic>
+#include <cstddef>
+#include <vector>
+
+namespace kvstore {
+
+    // 从大块内存(slab)中顺序切分出小块内存,只在析构时统一释放
+    class Arena {
+    public:
+        Arena();
+
+        ~Arena();
+
+        Arena(const Arena &arena) = delete;
+
+        Arena& operator=(const Arena &arena) = delete;
+
+        char *Allocate(size_t bytes);
+
+        char *AllocateAligned(size_t bytes);
+
+        // 已经向系统申请的内存总量(包括slab中未使用的部分)
+        size_t MemoryUsage() const {
+            return memory_usage_.load(std::memory_order_relaxed);
+        }
+
+    private:
+        static constexpr size_t kSlabSize = 64 * 1024;
+
+        char *AllocateFallback(size_t bytes);
+
+        char *AllocateNewSlab(size_t slab_bytes);
+
+        char *alloc_ptr_{nullptr};
+        size_t alloc_bytes_remaining_{0};
+        std::vector<char*> slabs_;
+        std::atomic<size_t> memory_usage_{0};
+    };
+
+}
+
+#endif //KVSTORE_ARENA_H
@@ -49,18 +49,18 @@ inline record_t *find(leaf_node_t &node, const key_t &key) {
 }
 
 //初始化
-BPlusTree::BPlusTree(const char *p, bool force_empty) : fp(nullptr), fp_level(0) {
+BPlusTree::BPlusTree(const char *p, bool force_empty) {
     memset(path, 0, sizeof(path));
     strcpy(path, p);
+    //不截断已有的文件,结点可以写在任何位置
+    file.OpenForWrite(path, force_empty);
     if (!force_empty)
         //从磁盘映射出来
         if (map(&meta, OFFSET_META) != 0)
             force_empty = true;
     if (force_empty) {
-        open_file("w+");
         //如果没有的话需要新建
         init_from_empty();
-        close_file();
     }
 }
 
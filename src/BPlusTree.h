@@ -11,6 +11,7 @@
 #include <cstdlib>
 #include <cassert>
 #include "BPlusTreePredefined.h"
+#include "DiskStorage.h"
 
 namespace kvstore {
 
@@ -172,24 +173,8 @@ namespace kvstore {
         template<class T>
         void node_remove(T *prev, T *node);
 
-        //文件打开/关闭
-        mutable FILE *fp;
-        mutable int fp_level;
-
-        void open_file(const char *mode = "rb+") const {
-            // `rb+` will make sure we can write everywhere without truncating file
-            if (fp_level == 0)
-                fp = fopen(path, mode);
-
-            ++fp_level;
-        }
-
-        void close_file() const {
-            if (fp_level == 1)
-                fclose(fp);
-
-            --fp_level;
-        }
+        //文件在构造时打开,析构时关闭,结点通过pread/pwrite按偏移读写
+        mutable DiskStorage file;
 
         //磁盘获取空间
         off_t alloc(size_t size) {
@@ -221,12 +206,7 @@ namespace kvstore {
 
         //从磁盘读取块
         int map(void *block, off_t offset, size_t size) const {
-            open_file();
-            fseek(fp, offset, SEEK_SET);
-            size_t rd = fread(block, size, 1, fp);
-            close_file();
-
-            return rd - 1;
+            return file.ReadAt(offset, size, static_cast<char *>(block)) ? 0 : -1;
         }
 
         template<class T>
@@ -236,12 +216,7 @@ namespace kvstore {
 
         //向磁盘写入块
         int unmap(void *block, off_t offset, size_t size) const {
-            open_file();
-            fseek(fp, offset, SEEK_SET);
-            size_t wd = fwrite(block, size, 1, fp);
-            close_file();
-
-            return wd - 1;
+            return file.WriteAt(offset, static_cast<const char *>(block), size) ? 0 : -1;
         }
 
         template<class T>
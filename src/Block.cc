@@ -0,0 +1,295 @@
+//
+// Created by 杨丰硕 on 2023/3/23.
+//
+#include <algorithm>
+#include <cassert>
+#include "Block.h"
+#include "Coding.h"
+
+using namespace kvstore;
+
+BlockBuilder::BlockBuilder(BlockFormat format, uint32_t restart_interval):
+        format_(format), restart_interval_(std::max<uint32_t>(restart_interval, 1)) {}
+
+void BlockBuilder::Add(uint64_t key, const Slice &value) {
+    assert(entry_cnt_ == 0 || last_key_ < key);
+    if (format_ == kRawFormat) {
+        keys_.push_back(key);
+        offsets_.push_back(values_.size());
+    } else if (entry_cnt_ % restart_interval_ == 0) {
+        restarts_.push_back(static_cast<uint32_t>(entries_.size()));
+        PutVarint64(&entries_, key);
+        PutVarint64(&entries_, values_.size());
+        PutVarint64(&entries_, value.size_);
+    } else {
+        PutVarint64(&entries_, key - last_key_);
+        PutVarint64(&entries_, value.size_);
+    }
+    values_.append(value.data_, value.size_);
+    last_key_ = key;
+    ++entry_cnt_;
+}
+
+size_t BlockBuilder::EstimatedSize() const {
+    if (format_ == kRawFormat) {
+        return values_.size() + (keys_.size() * 2 + 1) * sizeof(uint64_t);
+    }
+    return values_.size() + entries_.size() + (restarts_.size() + 3) * sizeof(uint32_t);
+}
+
+std::string BlockBuilder::Finish() {
+    std::string contents;
+    contents.reserve(EstimatedSize());
+    contents.swap(values_);
+    if (format_ == kRawFormat) {
+        for (uint64_t key : keys_) {
+            PutFixed64(&contents, key);
+        }
+        for (uint64_t offset : offsets_) {
+            PutFixed64(&contents, offset);
+        }
+        PutFixed64(&contents, entry_cnt_);
+    } else {
+        uint32_t entries_offset = static_cast<uint32_t>(contents.size());
+        contents += entries_;
+        for (uint32_t restart : restarts_) {        // restart记录的是在block中的位置
+            PutFixed32(&contents, entries_offset + restart);
+        }
+        PutFixed32(&contents, entries_offset);
+        PutFixed32(&contents, restart_interval_);
+        PutFixed32(&contents, static_cast<uint32_t>(entry_cnt_));
+    }
+    keys_.clear();
+    offsets_.clear();
+    entries_.clear();
+    restarts_.clear();
+    entry_cnt_ = 0;
+    return contents;
+}
+
+BlockReader::BlockReader(const Slice &contents, BlockFormat format): format_(format) {
+    if (format_ == kRawFormat) {
+        InitRaw(contents);
+    } else if (format_ == kCompactFormat) {
+        InitCompact(contents);
+    }
+}
+
+void BlockReader::InitRaw(const Slice &contents) {
+    if (contents.size_ < sizeof(uint64_t)) {
+        return;
+    }
+    size_t entry_cnt = DecodeFixed64(contents.data_ + contents.size_ - sizeof(uint64_t));
+    size_t max_entry_cnt = (contents.size_ - sizeof(uint64_t)) / (sizeof(uint64_t) * 2);
+    if (entry_cnt > max_entry_cnt) {
+        return;
+    }
+    entry_cnt_ = entry_cnt;
+    data_ = contents.data_;
+    offsets_ = contents.data_ + contents.size_ - sizeof(uint64_t) * (entry_cnt_ + 1);
+    keys_ = offsets_ - sizeof(uint64_t) * entry_cnt_;
+}
+
+void BlockReader::InitCompact(const Slice &contents) {
+    const size_t trailer_size = sizeof(uint32_t) * 3;
+    if (contents.size_ < trailer_size) {
+        return;
+    }
+    const char *trailer = contents.data_ + contents.size_ - trailer_size;
+    size_t entries_offset = DecodeFixed32(trailer);
+    uint32_t restart_interval = DecodeFixed32(trailer + sizeof(uint32_t));
+    size_t entry_cnt = DecodeFixed32(trailer + sizeof(uint32_t) * 2);
+    if (restart_interval == 0) {
+        return;
+    }
+    size_t restart_cnt = (entry_cnt + restart_interval - 1) / restart_interval;
+    size_t restarts_size = restart_cnt * sizeof(uint32_t);
+    if (restarts_size > contents.size_ - trailer_size
+        || entries_offset > contents.size_ - trailer_size - restarts_size) {
+        return;
+    }
+    data_ = contents.data_;
+    entry_cnt_ = entry_cnt;
+    restart_interval_ = restart_interval;
+    restart_cnt_ = restart_cnt;
+    entries_ = data_ + entries_offset;
+    restarts_ = trailer - restarts_size;
+}
+
+uint64_t BlockReader::KeyAt(size_t index) const {
+    if (format_ == kRawFormat) {
+        return DecodeFixed64(keys_ + index * sizeof(uint64_t));
+    }
+    Cursor cursor{};
+    EntryAt(index, &cursor);
+    return cursor.key_;
+}
+
+uint64_t BlockReader::OffsetAt(size_t index) const {
+    if (index == entry_cnt_) {      // 最后一个value一直延伸到key数组之前
+        return keys_ - data_;
+    }
+    return DecodeFixed64(offsets_ + index * sizeof(uint64_t));
+}
+
+bool BlockReader::RawValueAt(size_t index, Slice *value) const {
+    uint64_t begin = OffsetAt(index);
+    uint64_t end = OffsetAt(index + 1);
+    if (begin > end || end > static_cast<size_t>(keys_ - data_)) {      // offset被破坏
+        return false;
+    }
+    *value = Slice(data_ + begin, end - begin);
+    return true;
+}
+
+Slice BlockReader::ValueAt(size_t index) const {
+    if (format_ == kRawFormat) {
+        Slice value;
+        RawValueAt(index, &value);
+        return value;
+    }
+    Cursor cursor{};
+    if (!EntryAt(index, &cursor)) {
+        return Slice();
+    }
+    return Slice(data_ + cursor.value_offset_, cursor.value_size_);
+}
+
+size_t BlockReader::LowerBound(uint64_t key) const {
+    if (format_ == kCompactFormat) {
+        Cursor cursor{};
+        return SeekCompact(key, &cursor) ? cursor.index_ : entry_cnt_;
+    }
+    size_t left = 0, right = entry_cnt_;
+    while (left < right) {
+        size_t mid = left + (right - left) / 2;
+        if (KeyAt(mid) < key) {
+            left = mid + 1;
+        } else {
+            right = mid;
+        }
+    }
+    return left;
+}
+
+bool BlockReader::Get(uint64_t key, Slice *value) const {
+    if (!Valid()) {
+        return false;
+    }
+    if (format_ == kCompactFormat) {
+        Cursor cursor{};
+        if (!SeekCompact(key, &cursor) || cursor.index_ == entry_cnt_ || cursor.key_ != key) {
+            return false;
+        }
+        *value = Slice(data_ + cursor.value_offset_, cursor.value_size_);
+        return true;
+    }
+    size_t index = LowerBound(key);
+    if (index == entry_cnt_ || KeyAt(index) != key) {
+        return false;
+    }
+    return RawValueAt(index, value);
+}
+
+bool BlockReader::DecodeEntries(std::vector<uint64_t> *keys, std::vector<Slice> *values) const {
+    keys->clear();
+    values->clear();
+    if (!Valid()) {
+        return false;
+    }
+    keys->reserve(entry_cnt_);
+    values->reserve(entry_cnt_);
+    if (format_ == kRawFormat) {
+        Slice value;
+        for (size_t i = 0; i < entry_cnt_; ++i) {
+            if (!RawValueAt(i, &value)) {
+                return false;
+            }
+            keys->push_back(KeyAt(i));
+            values->push_back(value);
+        }
+        return true;
+    }
+    Cursor cursor{};
+    for (size_t i = 0; i < entry_cnt_; ++i) {
+        if (!(i == 0 ? SeekGroup(0, &cursor) : NextEntry(&cursor))) {
+            return false;
+        }
+        keys->push_back(cursor.key_);
+        values->push_back(Slice(data_ + cursor.value_offset_, cursor.value_size_));
+    }
+    return true;
+}
+
+uint64_t BlockReader::GroupFirstKey(size_t group) const {
+    uint64_t key = 0;
+    const char *p = data_ + DecodeFixed32(restarts_ + group * sizeof(uint32_t));
+    GetVarint64(p, restarts_, &key);
+    return key;
+}
+
+bool BlockReader::SeekGroup(size_t group, Cursor *cursor) const {
+    const char *p = data_ + DecodeFixed32(restarts_ + group * sizeof(uint32_t));
+    cursor->index_ = group * restart_interval_;
+    p = GetVarint64(p, restarts_, &cursor->key_);
+    p = p ? GetVarint64(p, restarts_, &cursor->value_offset_) : nullptr;
+    p = p ? GetVarint64(p, restarts_, &cursor->value_size_) : nullptr;
+    cursor->next_ = p;
+    return p != nullptr && cursor->value_offset_ + cursor->value_size_ <= static_cast<size_t>(entries_ - data_);
+}
+
+bool BlockReader::NextEntry(Cursor *cursor) const {
+    ++cursor->index_;
+    if (cursor->index_ % restart_interval_ == 0) {
+        return cursor->index_ < entry_cnt_ && SeekGroup(cursor->index_ / restart_interval_, cursor);
+    }
+    uint64_t key_delta = 0;
+    const char *p = GetVarint64(cursor->next_, restarts_, &key_delta);
+    cursor->key_ += key_delta;
+    cursor->value_offset_ += cursor->value_size_;
+    p = p ? GetVarint64(p, restarts_, &cursor->value_size_) : nullptr;
+    cursor->next_ = p;
+    return p != nullptr && cursor->value_offset_ + cursor->value_size_ <= static_cast<size_t>(entries_ - data_);
+}
+
+bool BlockReader::SeekCompact(uint64_t key, Cursor *cursor) const {
+    if (entry_cnt_ == 0) {
+        cursor->index_ = 0;
+        return true;
+    }
+    // 找到第一个首个key大于key的组,目标在它的前一组中
+    size_t left = 0, right = restart_cnt_;
+    while (left < right) {
+        size_t mid = left + (right - left) / 2;
+        if (GroupFirstKey(mid) <= key) {
+            left = mid + 1;
+        } else {
+            right = mid;
+        }
+    }
+    if (!SeekGroup(left == 0 ? 0 : left - 1, cursor)) {
+        return false;
+    }
+    while (cursor->key_ < key) {
+        if (cursor->index_ + 1 == entry_cnt_) {
+            cursor->index_ = entry_cnt_;
+            return true;
+        }
+        if (!NextEntry(cursor)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool BlockReader::EntryAt(size_t index, Cursor *cursor) const {
+    if (index >= entry_cnt_ || !SeekGroup(index / restart_interval_, cursor)) {
+        return false;
+    }
+    while (cursor->index_ < index) {
+        if (!NextEntry(cursor)) {
+            return false;
+        }
+    }
+    return true;
+}
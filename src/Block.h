@@ -0,0 +1,130 @@
+//
+// Created by 杨丰硕 on 2023/3/23.
+//
+
+#ifndef KVSTORE_BLOCK_H
+#define KVSTORE_BLOCK_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "Format.h"
+#include "Slice.h"
+
+namespace kvstore {
+
+    // kRawFormat的data block: [value]*n [key]*n [offset]*n [n],key,offset和n都是8字节.
+    // value紧密排列,第i个value在offset[i]和offset[i + 1](最后一个是key数组的起始位置)之间.
+    //
+    // kCompactFormat的data block: [value]*n [entry]*n [restart]*m [entry起始位置] [restart间隔] [n],
+    // restart和结尾的三个字段都是4字节.restart point处的entry是varint(key) varint(value的offset) varint(value的长度),
+    // 其余的entry是varint(和上一个key的差值) varint(value的长度),offset紧跟在上一个value之后.
+    // 每个restart记录一组entry的起始位置,可以对每组的第一个key做二分查找
+    class BlockBuilder {
+    public:
+        explicit BlockBuilder(BlockFormat format = kRawFormat, uint32_t restart_interval = 16);
+
+        // key必须严格递增
+        void Add(uint64_t key, const Slice &value);
+
+        void Add(uint64_t key, const std::string &value) {
+            Add(key, Slice(value));
+        }
+
+        // 生成block的内容并清空builder
+        std::string Finish();
+
+        size_t EstimatedSize() const;
+
+        bool Empty() const {
+            return entry_cnt_ == 0;
+        }
+
+        uint64_t LastKey() const {
+            return last_key_;
+        }
+
+    private:
+        BlockFormat format_;
+        uint32_t restart_interval_;
+        std::string values_;
+        size_t entry_cnt_{0};
+        uint64_t last_key_{0};
+        std::vector<uint64_t> keys_;        // kRawFormat
+        std::vector<uint64_t> offsets_;
+        std::string entries_;               // kCompactFormat
+        std::vector<uint32_t> restarts_;
+    };
+
+    // 在block内容上原地解析,不拷贝key和value,contents必须在BlockReader使用期间有效.
+    // kCompactFormat下按下标访问需要从所在组的restart point开始解码
+    class BlockReader {
+    public:
+        explicit BlockReader(const Slice &contents, BlockFormat format = kRawFormat);
+
+        // block的内容不完整时返回false
+        bool Valid() const {
+            return data_ != nullptr;
+        }
+
+        size_t GetEntryCount() const {
+            return entry_cnt_;
+        }
+
+        uint64_t KeyAt(size_t index) const;
+
+        // entry损坏时返回空Slice
+        Slice ValueAt(size_t index) const;
+
+        // 返回第一个不小于key的entry的下标
+        size_t LowerBound(uint64_t key) const;
+
+        bool Get(uint64_t key, Slice *value) const;
+
+        // 按顺序解码所有entry,kCompactFormat下只需要从头到尾解码一遍,适合遍历整个block
+        bool DecodeEntries(std::vector<uint64_t> *keys, std::vector<Slice> *values) const;
+
+    private:
+        // kCompactFormat下解码的位置
+        struct Cursor {
+            const char *next_;
+            size_t index_;
+            uint64_t key_;
+            uint64_t value_offset_;
+            uint64_t value_size_;
+        };
+
+        void InitRaw(const Slice &contents);
+
+        void InitCompact(const Slice &contents);
+
+        uint64_t OffsetAt(size_t index) const;
+
+        // offset不递增或越过key数组时返回false
+        bool RawValueAt(size_t index, Slice *value) const;
+
+        uint64_t GroupFirstKey(size_t group) const;
+
+        bool SeekGroup(size_t group, Cursor *cursor) const;
+
+        bool NextEntry(Cursor *cursor) const;
+
+        // 定位到第一个不小于key的entry,不存在时cursor->index_等于entry数量
+        bool SeekCompact(uint64_t key, Cursor *cursor) const;
+
+        bool EntryAt(size_t index, Cursor *cursor) const;
+
+        BlockFormat format_;
+        const char *data_{nullptr};
+        size_t entry_cnt_{0};
+        const char *keys_{nullptr};         // kRawFormat
+        const char *offsets_{nullptr};
+        const char *entries_{nullptr};      // kCompactFormat
+        const char *restarts_{nullptr};
+        size_t restart_cnt_{0};
+        uint32_t restart_interval_{0};
+    };
+
+}
+
+#endif //KVSTORE_BLOCK_H
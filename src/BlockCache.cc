@@ -0,0 +1,68 @@
+//
+// Created by 杨丰硕 on 2023/3/20.
+//
+#include "BlockCache.h"
+
+using namespace kvstore;
+
+BlockCache::BlockCache(size_t capacity, int shard_bits): capacity_(capacity) {
+    size_t shard_cnt = static_cast<size_t>(1) << shard_bits;
+    size_t shard_capacity = (capacity + shard_cnt - 1) / shard_cnt;
+    shards_.reserve(shard_cnt);
+    for (size_t i = 0; i < shard_cnt; ++i) {
+        shards_.emplace_back(new LRUShard(shard_capacity));
+    }
+}
+
+BlockCache::Block BlockCache::Lookup(uint64_t table_id, uint64_t blockno) {
+    CacheKey key{table_id, blockno};
+    return GetShard(key).Lookup(key);
+}
+
+void BlockCache::Insert(uint64_t table_id, uint64_t blockno, Block block) {
+    CacheKey key{table_id, blockno};
+    GetShard(key).Insert(key, std::move(block));
+}
+
+size_t BlockCache::GetUsage() const {
+    size_t usage = 0;
+    for (auto &shard : shards_) {
+        usage += shard->GetUsage();
+    }
+    return usage;
+}
+
+BlockCache::Block BlockCache::LRUShard::Lookup(const CacheKey &key) {
+    std::lock_guard<std::mutex> guard(mutex_);
+    auto findit = table_.find(key);
+    if (findit == table_.end()) {
+        return nullptr;
+    }
+    lru_.splice(lru_.begin(), lru_, findit->second);        // 移动到头部
+    return findit->second->second;
+}
+
+void BlockCache::LRUShard::Insert(const CacheKey &key, Block block) {
+    std::lock_guard<std::mutex> guard(mutex_);
+    auto findit = table_.find(key);
+    if (findit != table_.end()) {       // 并发读取同一个block时可能重复插入
+        usage_ -= findit->second->second->size();
+        lru_.erase(findit->second);
+        table_.erase(findit);
+    }
+    usage_ += block->size();
+    lru_.emplace_front(key, std::move(block));
+    table_[key] = lru_.begin();
+
+    while (usage_ > capacity_ && lru_.size() > 1) {      // 从尾部淘汰,刚插入的block至少保留
+        auto &victim = lru_.back();
+        usage_ -= victim.second->size();
+        table_.erase(victim.first);
+        lru_.pop_back();
+    }
+}
+
+size_t BlockCache::LRUShard::GetUsage() const {
+    std::lock_guard<std::mutex> guard(mutex_);
+    return usage_;
+}
@@ -0,0 +1,92 @@
+//
+// Created by 杨丰硕 on 2023/3/20.
+//
+
+#ifndef KVSTORE_BLOCKCACHE_H
+#define KVSTORE_BLOCKCACHE_H
+
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace kvstore {
+
+    // 被所有SSTable共享的block缓存,按(table_id, blockno)分片,每个分片是一个独立加锁的LRU.
+    // 缓存的是解码之后的block,被淘汰的block在使用者释放shared_ptr之前仍然有效
+    class BlockCache {
+    public:
+        using Block = std::shared_ptr<const std::string>;
+
+        explicit BlockCache(size_t capacity, int shard_bits = 4);
+
+        ~BlockCache() = default;
+
+        BlockCache(const BlockCache &cache) = delete;
+
+        BlockCache& operator=(const BlockCache &cache) = delete;
+
+        // 没有命中时返回nullptr
+        Block Lookup(uint64_t table_id, uint64_t blockno);
+
+        void Insert(uint64_t table_id, uint64_t blockno, Block block);
+
+        size_t GetCapacity() const {
+            return capacity_;
+        }
+
+        size_t GetUsage() const;
+
+    private:
+        struct CacheKey {
+            uint64_t table_id_;
+            uint64_t blockno_;
+
+            bool operator==(const CacheKey &key) const {
+                return table_id_ == key.table_id_ && blockno_ == key.blockno_;
+            }
+        };
+
+        struct CacheKeyHash {
+            size_t operator()(const CacheKey &key) const {
+                uint64_t hash = (key.table_id_ * 0x9e3779b97f4a7c15ULL) ^ key.blockno_;
+                return static_cast<size_t>(hash * 0xbf58476d1ce4e5b9ULL >> 16);
+            }
+        };
+
+        class LRUShard {
+        public:
+            explicit LRUShard(size_t capacity): capacity_(capacity) {}
+
+            Block Lookup(const CacheKey &key);
+
+            void Insert(const CacheKey &key, Block block);
+
+            size_t GetUsage() const;
+
+        private:
+            using Entry = std::pair<CacheKey, Block>;
+
+            using EntryList = std::list<Entry>;
+
+            mutable std::mutex mutex_;
+            EntryList lru_;     // 头部是最近被使用的
+            std::unordered_map<CacheKey, EntryList::iterator, CacheKeyHash> table_;
+            size_t capacity_;
+            size_t usage_{0};
+        };
+
+        LRUShard &GetShard(const CacheKey &key) {
+            return *shards_[CacheKeyHash()(key) & (shards_.size() - 1)];
+        }
+
+        size_t capacity_;
+        std::vector<std::unique_ptr<LRUShard>> shards_;
+    };
+
+}
+
+#endif //KVSTORE_BLOCKCACHE_H
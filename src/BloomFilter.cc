@@ -0,0 +1,70 @@
+//
+// Created by 杨丰硕 on 2023/3/22.
+//
+#include <algorithm>
+#include "BloomFilter.h"
+
+using namespace kvstore;
+
+BloomFilter::BloomFilter(int bits_per_key): bits_per_key_(std::max(bits_per_key, 1)) {
+    // k = bits_per_key * ln(2) 时误判率最低
+    hash_cnt_ = static_cast<int>(bits_per_key_ * 0.69);
+    hash_cnt_ = std::min(std::max(hash_cnt_, 1), 30);
+}
+
+void BloomFilter::AddKey(uint64_t key) {
+    hashes_.push_back(Hash(key));
+}
+
+std::string BloomFilter::Finish() {
+    // key很少时误判率会很高,所以至少使用64位
+    size_t bits = std::max<size_t>(hashes_.size() * bits_per_key_, 64);
+    size_t bytes = (bits + 7) / 8;
+    bits = bytes * 8;
+
+    std::string filter(bytes, '\0');
+    for (uint64_t hash : hashes_) {
+        uint32_t h = static_cast<uint32_t>(hash);
+        uint32_t delta = static_cast<uint32_t>(hash >> 32) | 1;
+        for (int i = 0; i < hash_cnt_; ++i) {
+            size_t bitpos = h % bits;
+            filter[bitpos / 8] |= static_cast<char>(1 << (bitpos % 8));
+            h += delta;
+        }
+    }
+    filter.push_back(static_cast<char>(hash_cnt_));
+    hashes_.clear();
+    return filter;
+}
+
+bool BloomFilter::KeyMayMatch(uint64_t key, const Slice &filter) {
+    if (filter.size_ < 2) {
+        return true;
+    }
+    size_t bits = (filter.size_ - 1) * 8;
+    int hash_cnt = static_cast<unsigned char>(filter.data_[filter.size_ - 1]);
+    if (hash_cnt > 30) {        // 保留给以后的编码方式,当作可能存在
+        return true;
+    }
+    uint64_t hash = Hash(key);
+    uint32_t h = static_cast<uint32_t>(hash);
+    uint32_t delta = static_cast<uint32_t>(hash >> 32) | 1;
+    for (int i = 0; i < hash_cnt; ++i) {
+        size_t bitpos = h % bits;
+        if ((filter.data_[bitpos / 8] & (1 << (bitpos % 8))) == 0) {
+            return false;
+        }
+        h += delta;
+    }
+    return true;
+}
+
+uint64_t BloomFilter::Hash(uint64_t key) {
+    // splitmix64的finalizer,连续的key也能被充分打散
+    key ^= key >> 30;
+    key *= 0xbf58476d1ce4e5b9ULL;
+    key ^= key >> 27;
+    key *= 0x94d049bb133111ebULL;
+    key ^= key >> 31;
+    return key;
+}
@@ -0,0 +1,43 @@
+//
+// Created by 杨丰硕 on 2023/3/22.
+//
+
+#ifndef KVSTORE_BLOOMFILTER_H
+#define KVSTORE_BLOOMFILTER_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "Slice.h"
+
+namespace kvstore {
+
+    // 为一个SSTable中的所有key构建Bloom filter,编码之后的格式是[bit数组][hash函数个数(1字节)].
+    // 使用double hashing,由一个64位hash的高低两半生成k个探测位置
+    class BloomFilter {
+    public:
+        explicit BloomFilter(int bits_per_key = 10);
+
+        void AddKey(uint64_t key);
+
+        // 生成编码之后的filter并清空已经添加的key
+        std::string Finish();
+
+        size_t GetKeyCount() const {
+            return hashes_.size();
+        }
+
+        // filter为空时总是返回true;返回false时key一定不存在
+        static bool KeyMayMatch(uint64_t key, const Slice &filter);
+
+    private:
+        static uint64_t Hash(uint64_t key);
+
+        int bits_per_key_;
+        int hash_cnt_;
+        std::vector<uint64_t> hashes_;
+    };
+
+}
+
+#endif //KVSTORE_BLOOMFILTER_H
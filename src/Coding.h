@@ -0,0 +1,73 @@
+//
+// Created by 杨丰硕 on 2023/3/23.
+//
+
+#ifndef KVSTORE_CODING_H
+#define KVSTORE_CODING_H
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+
+namespace kvstore {
+
+    // 定长整数按机器字节序编码,读写不要求地址对齐,memcpy会被编译成普通的load/store
+
+    inline void EncodeFixed64(char *buf, uint64_t value) {
+        std::memcpy(buf, &value, sizeof(value));
+    }
+
+    inline uint64_t DecodeFixed64(const char *buf) {
+        uint64_t value;
+        std::memcpy(&value, buf, sizeof(value));
+        return value;
+    }
+
+    inline void PutFixed64(std::string *dst, uint64_t value) {
+        char buf[sizeof(value)];
+        EncodeFixed64(buf, value);
+        dst->append(buf, sizeof(buf));
+    }
+
+    inline void EncodeFixed32(char *buf, uint32_t value) {
+        std::memcpy(buf, &value, sizeof(value));
+    }
+
+    inline uint32_t DecodeFixed32(const char *buf) {
+        uint32_t value;
+        std::memcpy(&value, buf, sizeof(value));
+        return value;
+    }
+
+    inline void PutFixed32(std::string *dst, uint32_t value) {
+        char buf[sizeof(value)];
+        EncodeFixed32(buf, value);
+        dst->append(buf, sizeof(buf));
+    }
+
+    // varint每个字节保存7位,最高位表示后面还有字节,小的整数只需要1到2个字节
+    inline void PutVarint64(std::string *dst, uint64_t value) {
+        while (value >= 0x80) {
+            dst->push_back(static_cast<char>(value | 0x80));
+            value >>= 7;
+        }
+        dst->push_back(static_cast<char>(value));
+    }
+
+    // 返回解析之后的下一个位置,数据不完整时返回nullptr
+    inline const char *GetVarint64(const char *p, const char *limit, uint64_t *value) {
+        uint64_t result = 0;
+        for (uint32_t shift = 0; shift <= 63 && p < limit; shift += 7) {
+            uint64_t byte = static_cast<unsigned char>(*p++);
+            result |= (byte & 0x7f) << shift;
+            if ((byte & 0x80) == 0) {
+                *value = result;
+                return p;
+            }
+        }
+        return nullptr;
+    }
+
+}
+
+#endif //KVSTORE_CODING_H
@@ -0,0 +1,46 @@
+//
+// Created by 杨丰硕 on 2023/3/14.
+//
+
+#ifndef KVSTORE_COMPARATOR_H
+#define KVSTORE_COMPARATOR_H
+
+#include <cassert>
+#include <functional>
+#include <type_traits>
+
+namespace kvstore {
+
+    // 默认的三路比较,只要求KEY支持operator<,可以被内联到跳表的查找循环中
+    template<class KEY>
+    struct DefaultComparator {
+        int operator()(const KEY &a, const KEY &b) const {
+            if (a < b) {
+                return -1;
+            }
+            return b < a ? 1 : 0;
+        }
+    };
+
+    // 需要运行时指定比较函数时使用,每次比较都要经过一次std::function的间接调用
+    template<class KEY>
+    class FunctionComparator {
+    public:
+        using Function = std::function<int(const KEY&, const KEY&)>;
+
+        template<class FUNC, class = typename std::enable_if<
+                !std::is_same<typename std::decay<FUNC>::type, FunctionComparator>::value>::type>
+        FunctionComparator(FUNC func): func_(std::move(func)) {}
+
+        int operator()(const KEY &a, const KEY &b) const {
+            assert(func_);
+            return func_(a, b);
+        }
+
+    private:
+        Function func_;
+    };
+
+}
+
+#endif //KVSTORE_COMPARATOR_H
@@ -0,0 +1,228 @@
+//
+// Created by 杨丰硕 on 2023/3/25.
+//
+#include <cstring>
+#include <vector>
+#include "Compression.h"
+#include "Coding.h"
+#ifdef KVSTORE_HAVE_ZLIB
+#include <zlib.h>
+#endif
+
+using namespace kvstore;
+
+namespace {
+
+    // 内置LZ格式: [varint(原始长度)] [sequence]*.每个sequence是一个token字节,高4位是literal的长度,
+    // 低4位是match的长度减4,等于15时后面还有若干个255和一个小于255的字节累加到长度上;
+    // 然后是literal本身,2字节的match距离和match长度的扩展字节.最后一个sequence只有literal
+    constexpr size_t kMinMatch = 4;
+    constexpr size_t kMaxDistance = 65535;
+    constexpr int kHashBits = 12;
+
+    inline uint32_t Load32(const char *p) {
+        uint32_t value;
+        std::memcpy(&value, p, sizeof(value));
+        return value;
+    }
+
+    inline uint32_t HashPosition(const char *p) {
+        return (Load32(p) * 2654435761U) >> (32 - kHashBits);
+    }
+
+    inline void PutLength(std::string *output, size_t length) {
+        while (length >= 255) {
+            output->push_back(static_cast<char>(255));
+            length -= 255;
+        }
+        output->push_back(static_cast<char>(length));
+    }
+
+    void PutSequence(std::string *output, const char *literal, size_t literal_size,
+                     size_t distance, size_t match_size) {
+        size_t match_code = match_size >= kMinMatch ? match_size - kMinMatch : 0;
+        uint8_t token = static_cast<uint8_t>((literal_size < 15 ? literal_size : 15) << 4);
+        token |= static_cast<uint8_t>(match_code < 15 ? match_code : 15);
+        output->push_back(static_cast<char>(token));
+        if (literal_size >= 15) {
+            PutLength(output, literal_size - 15);
+        }
+        output->append(literal, literal_size);
+        if (match_size == 0) {      // 最后一个sequence
+            return;
+        }
+        output->push_back(static_cast<char>(distance & 0xff));
+        output->push_back(static_cast<char>(distance >> 8));
+        if (match_code >= 15) {
+            PutLength(output, match_code - 15);
+        }
+    }
+
+    void LZCompress(const char *data, size_t size, std::string *output) {
+        PutVarint64(output, size);
+        std::vector<uint32_t> table(1 << kHashBits, UINT32_MAX);
+        const char *anchor = data;
+        size_t pos = 0;
+        // 结尾的几个字节不做匹配,保证Load32不会越界
+        while (size >= kMinMatch && pos + kMinMatch <= size) {
+            uint32_t hash = HashPosition(data + pos);
+            uint32_t candidate = table[hash];
+            table[hash] = static_cast<uint32_t>(pos);
+            if (candidate == UINT32_MAX || pos - candidate > kMaxDistance
+                || Load32(data + candidate) != Load32(data + pos)) {
+                ++pos;
+                continue;
+            }
+            size_t match_size = kMinMatch;
+            while (pos + match_size < size && data[candidate + match_size] == data[pos + match_size]) {
+                ++match_size;
+            }
+            PutSequence(output, anchor, data + pos - anchor, pos - candidate, match_size);
+            pos += match_size;
+            anchor = data + pos;
+        }
+        if (anchor < data + size) {
+            PutSequence(output, anchor, data + size - anchor, 0, 0);
+        }
+    }
+
+    inline bool GetLength(const char **p, const char *limit, size_t *length) {
+        while (*p < limit) {
+            uint8_t byte = static_cast<uint8_t>(*(*p)++);
+            *length += byte;
+            if (byte != 255) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    bool LZUncompress(const char *data, size_t size, std::string *output) {
+        const char *p = data, *limit = data + size;
+        uint64_t raw_size;
+        p = GetVarint64(p, limit, &raw_size);
+        // 每个输入字节最多展开成255 + 19个字节,用来拒绝损坏的长度
+        if (!p || raw_size > size * 274 + 64) {
+            return false;
+        }
+        output->resize(raw_size);
+        char *out = &(*output)[0], *out_begin = out, *out_limit = out + raw_size;
+        while (p < limit) {
+            uint8_t token = static_cast<uint8_t>(*p++);
+            size_t literal_size = token >> 4;
+            if (literal_size == 15 && !GetLength(&p, limit, &literal_size)) {
+                return false;
+            }
+            if (literal_size > static_cast<size_t>(limit - p) || literal_size > static_cast<size_t>(out_limit - out)) {
+                return false;
+            }
+            std::memcpy(out, p, literal_size);
+            out += literal_size;
+            p += literal_size;
+            if (p == limit) {
+                break;
+            }
+            if (limit - p < 2) {
+                return false;
+            }
+            size_t distance = static_cast<uint8_t>(p[0]) | (static_cast<size_t>(static_cast<uint8_t>(p[1])) << 8);
+            p += 2;
+            size_t match_size = token & 0x0f;
+            if (match_size == 15 && !GetLength(&p, limit, &match_size)) {
+                return false;
+            }
+            match_size += kMinMatch;
+            if (distance == 0 || distance > static_cast<size_t>(out - out_begin)
+                || match_size > static_cast<size_t>(out_limit - out)) {
+                return false;
+            }
+            const char *match = out - distance;
+            for (size_t i = 0; i < match_size; ++i) {       // 距离小于长度时match和输出重叠,只能逐字节拷贝
+                out[i] = match[i];
+            }
+            out += match_size;
+        }
+        return out == out_limit;
+    }
+
+#ifdef KVSTORE_HAVE_ZLIB
+    bool ZlibCompress(const char *data, size_t size, std::string *output) {
+        PutVarint64(output, size);
+        size_t header_size = output->size();
+        uLongf compressed_size = ::compressBound(size);
+        output->resize(header_size + compressed_size);
+        int ret = ::compress2(reinterpret_cast<Bytef *>(&(*output)[header_size]), &compressed_size,
+                              reinterpret_cast<const Bytef *>(data), size, Z_BEST_SPEED);
+        if (ret != Z_OK) {
+            return false;
+        }
+        output->resize(header_size + compressed_size);
+        return true;
+    }
+
+    bool ZlibUncompress(const char *data, size_t size, std::string *output) {
+        const char *limit = data + size;
+        uint64_t raw_size;
+        const char *p = GetVarint64(data, limit, &raw_size);
+        if (!p || raw_size > size * 1032 + 64) {        // deflate的最大压缩比大约是1032:1
+            return false;
+        }
+        output->resize(raw_size);
+        uLongf out_size = raw_size;
+        int ret = ::uncompress(reinterpret_cast<Bytef *>(&(*output)[0]), &out_size,
+                               reinterpret_cast<const Bytef *>(p), limit - p);
+        return ret == Z_OK && out_size == raw_size;
+    }
+#endif
+
+}
+
+bool kvstore::IsCompressionSupported(CompressionType type) {
+    switch (type) {
+        case kNoCompression:
+        case kLZCompression:
+            return true;
+        case kZlibCompression:
+#ifdef KVSTORE_HAVE_ZLIB
+            return true;
+#else
+            return false;
+#endif
+    }
+    return false;
+}
+
+bool kvstore::Compress(CompressionType type, const char *data, size_t size, std::string *output) {
+    switch (type) {
+        case kNoCompression:
+            output->append(data, size);
+            return true;
+        case kLZCompression:
+            LZCompress(data, size, output);
+            return true;
+        case kZlibCompression:
+#ifdef KVSTORE_HAVE_ZLIB
+            return ZlibCompress(data, size, output);
+#else
+            return false;
+#endif
+    }
+    return false;
+}
+
+bool kvstore::Uncompress(CompressionType type, const char *data, size_t size, std::string *output) {
+    switch (type) {
+        case kNoCompression:
+            output->assign(data, size);
+            return true;
+        case kLZCompression:
+            return LZUncompress(data, size, output);
+        case kZlibCompression:
+#ifdef KVSTORE_HAVE_ZLIB
+            return ZlibUncompress(data, size, output);
+#else
+            return false;
+#endif
+    }
+    return false;
+}
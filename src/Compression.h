@@ -0,0 +1,32 @@
+//
+// Created by 杨丰硕 on 2023/3/25.
+//
+
+#ifndef KVSTORE_COMPRESSION_H
+#define KVSTORE_COMPRESSION_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace kvstore {
+
+    // 写在每个data block头部的压缩类型
+    enum CompressionType : uint8_t {
+        kNoCompression = 0,
+        kLZCompression = 1,         // 内置的LZ77压缩,格式和LZ4类似,速度优先
+        kZlibCompression = 2,       // 编译时找到zlib才可用
+    };
+
+    // 当前编译的版本是否支持这种压缩类型
+    bool IsCompressionSupported(CompressionType type);
+
+    // 压缩结果追加到output中,不支持的类型返回false
+    bool Compress(CompressionType type, const char *data, size_t size, std::string *output);
+
+    // 解压结果写到output中,数据损坏或者不支持的类型返回false
+    bool Uncompress(CompressionType type, const char *data, size_t size, std::string *output);
+
+}
+
+#endif //KVSTORE_COMPRESSION_H
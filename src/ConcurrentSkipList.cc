@@ -0,0 +1,178 @@
+//
+// Created by 杨丰硕 on 2023/3/13.
+//
+#include "ConcurrentSkipList.h"
+using namespace kvstore;
+
+template<class KEY, class VALUE, class COMPARATOR>
+ConcurrentSkipList<KEY, VALUE, COMPARATOR>::~ConcurrentSkipList() {
+    // 析构时已经没有并发访问,被删除的结点仍在第0层链表中
+    NodePtr curr_node = header_;
+    while (curr_node) {
+        auto next_node = curr_node->GetNext(0);
+        curr_node->~Node();
+        ::operator delete(curr_node);
+        curr_node = next_node;
+    }
+    auto holder = holders_.load(std::memory_order_relaxed);
+    while (holder) {
+        auto next_holder = holder->next_holder_;
+        delete holder;
+        holder = next_holder;
+    }
+}
+
+template<class KEY, class VALUE, class COMPARATOR>
+bool ConcurrentSkipList<KEY, VALUE, COMPARATOR>::Put(const KEY &key, const VALUE &value) {
+    NodePtr prenodes[kMaxHeight];
+    NodePtr nextnodes[kMaxHeight];
+    // 从所有层的顶部开始找,这样不需要关心curr_height_被其他写者并发修改
+    NodePtr before = header_;
+    for (int i = kMaxHeight - 1; i >= 0; --i) {
+        FindSpliceForLevel(key, before, i, &prenodes[i], &nextnodes[i]);
+        before = prenodes[i];
+    }
+
+    auto holder = NewHolder(value);
+    if (nextnodes[0] && Equal(nextnodes[0]->key_, key)) {       // 该key已经存在
+        ReplaceValue(nextnodes[0], holder);
+        return true;
+    }
+
+    int newheight = GetRandomHeight();
+    int max_height = curr_height_.load(std::memory_order_relaxed);
+    while (newheight > max_height) {
+        if (curr_height_.compare_exchange_weak(max_height, newheight, std::memory_order_relaxed)) {
+            break;
+        }
+    }
+
+    auto newnode = new (::operator new(Node::AllocSize(newheight))) Node(key, holder, newheight);
+    memory_usage_.fetch_add(Node::AllocSize(newheight), std::memory_order_relaxed);
+    for (int i = 0; i < newheight; ++i) {
+        while (true) {
+            newnode->NoBarrierSetNext(i, nextnodes[i]);
+            if (prenodes[i]->CasNext(i, nextnodes[i], newnode)) {
+                break;
+            }
+            // 有其他写者在prenodes[i]之后插入了结点,从prenodes[i]重新查找
+            FindSpliceForLevel(key, prenodes[i], i, &prenodes[i], &nextnodes[i]);
+            if (i == 0 && nextnodes[0] && Equal(nextnodes[0]->key_, key)) {
+                // 相同的key被并发插入了,新结点还没有被发布,可以直接释放
+                memory_usage_.fetch_sub(Node::AllocSize(newheight), std::memory_order_relaxed);
+                newnode->~Node();
+                ::operator delete(newnode);
+                ReplaceValue(nextnodes[0], holder);
+                return true;
+            }
+        }
+    }
+    return true;
+}
+
+template<class KEY, class VALUE, class COMPARATOR>
+bool ConcurrentSkipList<KEY, VALUE, COMPARATOR>::Get(const KEY &key, VALUE *value) const {
+    auto findnode = FindGreaterOrEqual(key);
+    if (findnode && Equal(findnode->key_, key)) {
+        auto findvalue = findnode->GetValue();
+        if (findvalue) {
+            *value = *findvalue;
+            return true;
+        }
+    }
+    return false;
+}
+
+template<class KEY, class VALUE, class COMPARATOR>
+bool ConcurrentSkipList<KEY, VALUE, COMPARATOR>::Delete(const KEY &key) {
+    auto findnode = FindGreaterOrEqual(key);
+    if (findnode == nullptr || !Equal(findnode->key_, key)) {
+        return false;
+    }
+    auto old_holder = findnode->ExchangeValue(nullptr);
+    if (!old_holder) {
+        return false;
+    }
+    garbage_usage_.fetch_add(HolderSize(old_holder) + Node::AllocSize(findnode->GetNextSize()),
+                             std::memory_order_relaxed);
+    return true;
+}
+
+template<class KEY, class VALUE, class COMPARATOR>
+void ConcurrentSkipList<KEY, VALUE, COMPARATOR>::Dump() {
+    for (int i = 0; i < kMaxHeight; ++i) {
+        std::cout << "header,";
+    }
+    std::cout << '\n';
+    auto curr_node = header_->GetNext(0);
+    while (curr_node) {
+        if (curr_node->GetValue()) {
+            int next_len = curr_node->GetNextSize();
+            for (int i = 0; i < next_len; ++i) {
+                std::cout << curr_node->key_ << ',';
+            }
+            std::cout << '\n';
+        }
+        curr_node = curr_node->GetNext(0);
+    }
+}
+
+template<class KEY, class VALUE, class COMPARATOR>
+ValueHolder<VALUE>* ConcurrentSkipList<KEY, VALUE, COMPARATOR>::NewHolder(const VALUE &value) {
+    auto holder = new Holder(value);
+    memory_usage_.fetch_add(HolderSize(holder), std::memory_order_relaxed);
+    auto head = holders_.load(std::memory_order_relaxed);
+    do {
+        holder->next_holder_ = head;
+    } while (!holders_.compare_exchange_weak(head, holder, std::memory_order_release,
+                                             std::memory_order_relaxed));
+    return holder;
+}
+
+template<class KEY, class VALUE, class COMPARATOR>
+void ConcurrentSkipList<KEY, VALUE, COMPARATOR>::ReplaceValue(NodePtr node, Holder *holder) {
+    auto old_holder = node->ExchangeValue(holder);
+    if (old_holder) {
+        garbage_usage_.fetch_add(HolderSize(old_holder), std::memory_order_relaxed);
+    } else {        // 被删除的结点重新可见
+        garbage_usage_.fetch_sub(Node::AllocSize(node->GetNextSize()), std::memory_order_relaxed);
+    }
+}
+
+template<class KEY, class VALUE, class COMPARATOR>
+ConcurrentNode<KEY, VALUE>* ConcurrentSkipList<KEY, VALUE, COMPARATOR>::FindGreaterOrEqual(const KEY &key) const {
+    auto curr_node = header_;
+    int curr_level = GetCurrHeight() - 1;
+
+    while (true) {
+        auto next_node = curr_node->GetNext(curr_level);
+        if (next_node && Less(next_node->key_, key)) {
+            curr_node = next_node;
+        } else {
+            if (curr_level == 0) {
+                return next_node;
+            }
+            --curr_level;
+        }
+    }
+}
+
+template<class KEY, class VALUE, class COMPARATOR>
+void ConcurrentSkipList<KEY, VALUE, COMPARATOR>::FindSpliceForLevel(const KEY &key, NodePtr before, int level,
+                                                                    NodePtr *prev, NodePtr *next) const {
+    while (true) {
+        auto next_node = before->GetNext(level);
+        if (next_node && Less(next_node->key_, key)) {
+            before = next_node;
+        } else {
+            *prev = before;
+            *next = next_node;
+            return;
+        }
+    }
+}
+
+template<class KEY, class VALUE, class COMPARATOR>
+int ConcurrentSkipList<KEY, VALUE, COMPARATOR>::GetRandomHeight() {
+    return HeightGenerator::ThreadLocal().NextHeight(kMaxHeight);       // 每个写者线程各自一个
+}
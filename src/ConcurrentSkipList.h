@@ -0,0 +1,246 @@
+//
+// Created by 杨丰硕 on 2023/3/13.
+//
+
+#ifndef KVSTORE_CONCURRENTSKIPLIST_H
+#define KVSTORE_CONCURRENTSKIPLIST_H
+
+#include <atomic>
+#include <cassert>
+#include <cstddef>
+#include <iostream>
+#include <new>
+#include <string>
+#include "Comparator.h"
+#include "Utils.h"
+#include "KvContainer.h"
+
+namespace kvstore {
+
+    // value保存在独立的holder中,覆盖写时原子地替换holder指针,旧的holder在跳表析构时统一释放
+    template<class VALUE>
+    struct ValueHolder {
+        const VALUE value_;
+        ValueHolder *next_holder_{nullptr};     // 用于析构时找到所有分配过的holder
+
+        explicit ValueHolder(const VALUE &value): value_(value) {}
+    };
+
+    // value在holder之外占用的内存,用于统计跳表的内存占用
+    template<class VALUE>
+    inline size_t ValueHeapSize(const VALUE &) {
+        return 0;
+    }
+
+    inline size_t ValueHeapSize(const std::string &value) {
+        return value.capacity();
+    }
+
+    template<class KEY, class VALUE>
+    struct ConcurrentNode {
+        using NodePtr = ConcurrentNode*;
+
+        using Holder = ValueHolder<VALUE>;
+
+        const KEY key_{};
+
+        ConcurrentNode(const KEY &key, Holder *holder, int level): key_(key), value_(holder), height_(level) {
+            InitNexts();
+        }
+
+        explicit ConcurrentNode(int level): value_(nullptr), height_(level) {
+            InitNexts();
+        }
+
+        ~ConcurrentNode() = default;
+
+        static size_t AllocSize(int level) {
+            assert(level > 0);
+            return sizeof(ConcurrentNode) + sizeof(std::atomic<NodePtr>) * (level - 1);
+        }
+
+        // acquire保证能看到next结点被发布之前的全部初始化
+        NodePtr GetNext(int n) const {
+            assert(n >= 0 && n < height_);
+            return nexts_[n].load(std::memory_order_acquire);
+        }
+
+        void SetNext(int n, NodePtr node) {
+            assert(n >= 0 && n < height_);
+            nexts_[n].store(node, std::memory_order_release);
+        }
+
+        // 只在结点还未被发布时使用
+        void NoBarrierSetNext(int n, NodePtr node) {
+            assert(n >= 0 && n < height_);
+            nexts_[n].store(node, std::memory_order_relaxed);
+        }
+
+        bool CasNext(int n, NodePtr expected, NodePtr node) {
+            assert(n >= 0 && n < height_);
+            return nexts_[n].compare_exchange_strong(expected, node, std::memory_order_acq_rel);
+        }
+
+        int GetNextSize() const {
+            return height_;
+        }
+
+        // 返回nullptr表示该key已经被删除
+        const VALUE *GetValue() const {
+            auto holder = value_.load(std::memory_order_acquire);
+            return holder ? &holder->value_ : nullptr;
+        }
+
+        Holder *ExchangeValue(Holder *holder) {
+            return value_.exchange(holder, std::memory_order_acq_rel);
+        }
+
+    private:
+        void InitNexts() {
+            for (int i = 0; i < height_; ++i) {
+                new (&nexts_[i]) std::atomic<NodePtr>(nullptr);
+            }
+        }
+
+        std::atomic<Holder*> value_;
+        const int height_;
+        std::atomic<NodePtr> nexts_[1];     // 实际长度为height_,紧跟在结点之后分配
+    };
+
+    template<class KEY, class VALUE, class COMPARATOR>
+    class ConcurrentSkipListIterator;
+
+    // 支持多读多写的跳表: Put通过CAS链接结点, Get和迭代器不加锁也不会被写者阻塞.
+    // Delete只是把结点标记为删除.没有epoch或者hazard pointer这样的回收机制,读者随时可能还在访问旧的value,
+    // 所以被覆盖的value和被删除的结点都要等到跳表析构时才释放,之后对同一个key的Put会复用被删除的结点.
+    // 只适合memtable这样写满之后整体丢弃的用途,覆盖写很多时调用者应该根据MemoryUsage()及时换用新的跳表
+    template<class KEY, class VALUE, class COMPARATOR = DefaultComparator<KEY>>
+    class ConcurrentSkipList: public KvContainer<KEY, VALUE> {
+    public:
+
+        friend class ConcurrentSkipListIterator<KEY, VALUE, COMPARATOR>;
+
+        using Node = ConcurrentNode<KEY, VALUE>;
+
+        using NodePtr = Node*;
+
+        using Holder = ValueHolder<VALUE>;
+
+        using Comparator = COMPARATOR;
+
+        explicit ConcurrentSkipList(Comparator comparator = Comparator()): compare_(std::move(comparator)) {
+            header_ = new (::operator new(Node::AllocSize(kMaxHeight))) Node(kMaxHeight);
+        }
+
+        ~ConcurrentSkipList();
+
+        ConcurrentSkipList(const ConcurrentSkipList &skipList) = delete;
+
+        ConcurrentSkipList& operator=(const ConcurrentSkipList &skipList) = delete;
+
+        bool Put(const KEY &key, const VALUE &value) override;
+
+        bool Get(const KEY &key, VALUE *value) const override;
+
+        bool Delete(const KEY &key) override;
+
+        void Dump() override;
+
+        ContainType GetType() override {
+            return SKIPLIST_CTYPE;
+        }
+
+        int GetCurrHeight() const {
+            return curr_height_.load(std::memory_order_relaxed);
+        }
+
+        // 所有结点和value占用的内存,包括还没有释放的被覆盖的value和被删除的结点
+        size_t MemoryUsage() const {
+            return memory_usage_.load(std::memory_order_relaxed);
+        }
+
+        // 被覆盖的value和被删除的结点占用的内存,它们在跳表析构之前不会被释放.
+        // 并发的Delete和Put可能以相反的顺序更新计数,中间值可能暂时为负
+        size_t GarbageUsage() const {
+            auto usage = garbage_usage_.load(std::memory_order_relaxed);
+            return usage > 0 ? static_cast<size_t>(usage) : 0;
+        }
+
+    private:
+
+        static constexpr uint8_t kMaxHeight = 12;
+
+        bool Equal(const KEY &a, const KEY &b) const {
+            return compare_(a, b) == 0;
+        }
+
+        bool Less(const KEY &a, const KEY &b) const {
+            return compare_(a, b) < 0;
+        }
+
+        int GetRandomHeight();
+
+        Holder *NewHolder(const VALUE &value);
+
+        static size_t HolderSize(const Holder *holder) {
+            return sizeof(Holder) + ValueHeapSize(holder->value_);
+        }
+
+        // 替换已经存在的结点的value,把被替换的value或者被复用的结点从垃圾中计入或者移除
+        void ReplaceValue(NodePtr node, Holder *holder);
+
+        NodePtr FindGreaterOrEqual(const KEY &key) const;
+
+        // 从before出发,在level层找到prev < key <= next的位置
+        void FindSpliceForLevel(const KEY &key, NodePtr before, int level,
+                                NodePtr *prev, NodePtr *next) const;
+
+        NodePtr header_{nullptr};
+        Comparator compare_;
+        std::atomic<Holder*> holders_{nullptr};
+        std::atomic<int> curr_height_{1};
+        std::atomic<size_t> memory_usage_{0};
+        std::atomic<ptrdiff_t> garbage_usage_{0};
+    };
+
+    template<class KEY, class VALUE, class COMPARATOR = DefaultComparator<KEY>>
+    class ConcurrentSkipListIterator {
+    public:
+        using ConstNodePtr = const ConcurrentNode<KEY, VALUE>*;
+
+        using ConstSkipList = const ConcurrentSkipList<KEY, VALUE, COMPARATOR>;
+
+        explicit ConcurrentSkipListIterator(const ConstSkipList &skiplist): skip_list_(skiplist) {}
+
+        void Init() {
+            curr_node_ = skip_list_.header_;
+        }
+
+        // 跳过已经被标记删除的结点. 返回的结点之后仍可能被并发删除,此时GetValue()返回nullptr
+        bool HasNext() {
+            auto next_node = curr_node_ ? curr_node_->GetNext(0) : nullptr;
+            while (next_node && !next_node->GetValue()) {
+                next_node = next_node->GetNext(0);
+            }
+            next_node_ = next_node;
+            return next_node != nullptr;
+        }
+
+        ConstNodePtr Next() {
+            assert(curr_node_);
+            if (!next_node_) {
+                HasNext();
+            }
+            curr_node_ = next_node_;
+            next_node_ = nullptr;
+            return curr_node_;
+        }
+
+    private:
+        ConstSkipList &skip_list_;
+        ConstNodePtr curr_node_{nullptr};
+        ConstNodePtr next_node_{nullptr};
+    };
+}
+
+#endif //KVSTORE_CONCURRENTSKIPLIST_H
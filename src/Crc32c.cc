@@ -0,0 +1,145 @@
+//
+// Created by 杨丰硕 on 2023/3/28.
+//
+#include <cstring>
+#include "Crc32c.h"
+#if defined(__x86_64__)
+#include <nmmintrin.h>
+#define KVSTORE_X86_64 1
+#endif
+
+using namespace kvstore;
+
+namespace {
+
+    // 反转之后的Castagnoli多项式
+    constexpr uint32_t kCrc32cPoly = 0x82f63b78;
+
+    // tables[k][b]是字节b后面再跟k个0字节的校验和,一次可以处理8个字节
+    struct Crc32cTables {
+        uint32_t tables_[8][256];
+
+        Crc32cTables() {
+            for (uint32_t b = 0; b < 256; ++b) {
+                uint32_t crc = b;
+                for (int i = 0; i < 8; ++i) {
+                    crc = (crc >> 1) ^ (kCrc32cPoly & (0u - (crc & 1)));
+                }
+                tables_[0][b] = crc;
+            }
+            for (uint32_t b = 0; b < 256; ++b) {
+                for (int k = 1; k < 8; ++k) {
+                    uint32_t prev = tables_[k - 1][b];
+                    tables_[k][b] = (prev >> 8) ^ tables_[0][prev & 0xff];
+                }
+            }
+        }
+    };
+
+    const Crc32cTables &GetTables() {
+        static const Crc32cTables tables;
+        return tables;
+    }
+
+    // 硬件路径把数据分成3条互不依赖的流并行计算,每条流每轮处理kStripeSize字节
+    constexpr size_t kStripeSize = 256;
+
+    // 在没有取反的crc状态后面补kStripeSize个0字节,这个运算是线性的,可以按状态的每个字节分别查表
+    struct Crc32cShiftTable {
+        uint32_t tables_[4][256];
+
+        Crc32cShiftTable() {
+            auto &t = GetTables().tables_[0];
+            for (int j = 0; j < 4; ++j) {
+                for (uint32_t b = 0; b < 256; ++b) {
+                    uint32_t state = b << (8 * j);
+                    for (size_t i = 0; i < kStripeSize; ++i) {
+                        state = (state >> 8) ^ t[state & 0xff];
+                    }
+                    tables_[j][b] = state;
+                }
+            }
+        }
+
+        uint32_t Shift(uint32_t state) const {
+            return tables_[0][state & 0xff] ^ tables_[1][(state >> 8) & 0xff]
+                   ^ tables_[2][(state >> 16) & 0xff] ^ tables_[3][state >> 24];
+        }
+    };
+
+    const Crc32cShiftTable &GetShiftTable() {
+        static const Crc32cShiftTable table;
+        return table;
+    }
+
+#ifdef KVSTORE_X86_64
+    __attribute__((target("sse4.2")))
+    uint32_t HardwareExtendCrc32c(uint32_t crc, const char *data, size_t size) {
+        uint64_t state = ~crc;
+        // crc32指令的延迟是3个周期,单条依赖链只能用满三分之一的吞吐
+        if (size >= kStripeSize * 3) {
+            auto &shift = GetShiftTable();
+            for (; size >= kStripeSize * 3; size -= kStripeSize * 3, data += kStripeSize * 3) {
+                uint64_t a = state, b = 0, c = 0;
+                for (size_t i = 0; i < kStripeSize; i += sizeof(uint64_t)) {
+                    uint64_t wa, wb, wc;
+                    std::memcpy(&wa, data + i, sizeof(wa));
+                    std::memcpy(&wb, data + kStripeSize + i, sizeof(wb));
+                    std::memcpy(&wc, data + kStripeSize * 2 + i, sizeof(wc));
+                    a = _mm_crc32_u64(a, wa);
+                    b = _mm_crc32_u64(b, wb);
+                    c = _mm_crc32_u64(c, wc);
+                }
+                // crc(a||b) = shift(crc(a)) ^ crc(b),其中b的初始状态为0
+                state = shift.Shift(shift.Shift(static_cast<uint32_t>(a)) ^ static_cast<uint32_t>(b))
+                        ^ static_cast<uint32_t>(c);
+            }
+        }
+        for (; size >= sizeof(uint64_t); size -= sizeof(uint64_t), data += sizeof(uint64_t)) {
+            uint64_t word;
+            std::memcpy(&word, data, sizeof(word));
+            state = _mm_crc32_u64(state, word);
+        }
+        auto state32 = static_cast<uint32_t>(state);
+        for (; size > 0; --size, ++data) {
+            state32 = _mm_crc32_u8(state32, static_cast<uint8_t>(*data));
+        }
+        return ~state32;
+    }
+#endif
+
+}
+
+bool kvstore::HasHardwareCrc32c() {
+#ifdef KVSTORE_X86_64
+    static const bool has_sse42 = __builtin_cpu_supports("sse4.2");
+    return has_sse42;
+#else
+    return false;
+#endif
+}
+
+uint32_t kvstore::PortableExtendCrc32c(uint32_t crc, const char *data, size_t size) {
+    auto &t = GetTables().tables_;
+    auto p = reinterpret_cast<const uint8_t *>(data);
+    uint32_t state = ~crc;
+    for (; size >= 8; size -= 8, p += 8) {
+        // 按小端序把前4个字节合并进状态,8个字节分别查表之后异或
+        uint32_t low = state ^ (p[0] | p[1] << 8 | p[2] << 16 | static_cast<uint32_t>(p[3]) << 24);
+        state = t[7][low & 0xff] ^ t[6][(low >> 8) & 0xff] ^ t[5][(low >> 16) & 0xff] ^ t[4][low >> 24]
+                ^ t[3][p[4]] ^ t[2][p[5]] ^ t[1][p[6]] ^ t[0][p[7]];
+    }
+    for (; size > 0; --size, ++p) {
+        state = (state >> 8) ^ t[0][(state ^ *p) & 0xff];
+    }
+    return ~state;
+}
+
+uint32_t kvstore::ExtendCrc32c(uint32_t crc, const char *data, size_t size) {
+#ifdef KVSTORE_X86_64
+    if (HasHardwareCrc32c()) {
+        return HardwareExtendCrc32c(crc, data, size);
+    }
+#endif
+    return PortableExtendCrc32c(crc, data, size);
+}
@@ -0,0 +1,29 @@
+//
+// Created by 杨丰硕 on 2023/3/28.
+//
+
+#ifndef KVSTORE_CRC32C_H
+#define KVSTORE_CRC32C_H
+
+#include <cstddef>
+#include <cstdint>
+
+namespace kvstore {
+
+    // CRC32C(Castagnoli多项式),支持SSE4.2时使用crc32指令,否则查表计算,两者的结果相同.
+    // crc是之前的数据的校验和,可以分段计算,第一段传入0
+    uint32_t ExtendCrc32c(uint32_t crc, const char *data, size_t size);
+
+    inline uint32_t Crc32c(const char *data, size_t size) {
+        return ExtendCrc32c(0, data, size);
+    }
+
+    // 查表的实现,不使用crc32指令
+    uint32_t PortableExtendCrc32c(uint32_t crc, const char *data, size_t size);
+
+    // 当前CPU是否支持SSE4.2,只检测一次
+    bool HasHardwareCrc32c();
+
+}
+
+#endif //KVSTORE_CRC32C_H
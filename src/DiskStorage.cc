@@ -1,4 +1,215 @@
 //
 // Created by 杨丰硕 on 2023/3/9.
 //
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "DiskStorage.h"
 
+using namespace kvstore;
+
+constexpr const uint64_t DiskStorage::BLOCK_SIZE;
+constexpr size_t DiskStorage::kAlignment;
+
+namespace {
+
+    bool PreadAll(int fd, uint64_t offset, size_t size, char *buf) {
+        while (size > 0) {
+            ssize_t read_size = ::pread(fd, buf, size, static_cast<off_t>(offset));
+            if (read_size < 0 && errno == EINTR) {
+                continue;
+            }
+            if (read_size <= 0) {
+                return false;
+            }
+            buf += read_size;
+            offset += read_size;
+            size -= read_size;
+        }
+        return true;
+    }
+
+    bool PwriteAll(int fd, uint64_t offset, const char *data, size_t size) {
+        while (size > 0) {
+            ssize_t write_size = ::pwrite(fd, data, size, static_cast<off_t>(offset));
+            if (write_size < 0 && errno == EINTR) {
+                continue;
+            }
+            if (write_size <= 0) {
+                return false;
+            }
+            data += write_size;
+            offset += write_size;
+            size -= write_size;
+        }
+        return true;
+    }
+
+}
+
+DiskStorage::~DiskStorage() {
+    Close();
+}
+
+bool DiskStorage::OpenForRead(const std::string &path, const FileOptions &options) {
+    return Open(path, O_RDONLY, options);
+}
+
+bool DiskStorage::OpenForWrite(const std::string &path, bool truncate, const FileOptions &options) {
+    return Open(path, O_RDWR | O_CREAT | (truncate ? O_TRUNC : 0), options);
+}
+
+bool DiskStorage::Open(const std::string &path, int flags, const FileOptions &options) {
+    Close();
+    options_ = options;
+    bool writable = (flags & O_ACCMODE) != O_RDONLY;
+    if (writable && options_.direct_io_) {
+        fd_ = ::open(path.c_str(), flags | O_DIRECT, 0644);
+        direct_io_ = fd_ >= 0;
+    }
+    if (fd_ < 0) {      // tmpfs这样的文件系统不支持O_DIRECT
+        fd_ = ::open(path.c_str(), flags, 0644);
+    }
+    if (fd_ < 0) {
+        return false;
+    }
+    Advise(options_.access_pattern_);
+    if (!writable) {
+        return true;
+    }
+    buffer_capacity_ = std::max<size_t>(options_.buffer_size_, kAlignment);
+    buffer_capacity_ = (buffer_capacity_ + kAlignment - 1) / kAlignment * kAlignment;
+    void *buffer = nullptr;
+    if (::posix_memalign(&buffer, kAlignment, buffer_capacity_) != 0) {
+        Close();
+        return false;
+    }
+    buffer_.reset(static_cast<char *>(buffer));
+    append_offset_ = Size();
+    if (direct_io_ && append_offset_ % kAlignment != 0) {
+        DisableDirectIO();
+    }
+    return true;
+}
+
+bool DiskStorage::Close() {
+    bool ok = true;
+    if (fd_ >= 0) {
+        ok = ::close(fd_) == 0;
+        fd_ = -1;
+    }
+    direct_io_ = false;
+    buffer_.reset();
+    buffer_capacity_ = buffer_used_ = 0;
+    append_offset_ = 0;
+    return ok;
+}
+
+uint64_t DiskStorage::Size() const {
+    struct stat file_stat{};
+    if (fd_ < 0 || ::fstat(fd_, &file_stat) != 0) {
+        return 0;
+    }
+    return file_stat.st_size;
+}
+
+bool DiskStorage::ReadAt(uint64_t offset, size_t size, char *buf) const {
+    return fd_ >= 0 && PreadAll(fd_, offset, size, buf);
+}
+
+bool DiskStorage::WriteAt(uint64_t offset, const char *data, size_t size) {
+    if (fd_ < 0 || (direct_io_ && !DisableDirectIO())) {
+        return false;
+    }
+    return PwriteAll(fd_, offset, data, size);
+}
+
+bool DiskStorage::Append(const char *data, size_t size) {
+    if (!buffer_) {
+        return false;
+    }
+    while (size > 0) {
+        size_t copy_size = std::min(size, buffer_capacity_ - buffer_used_);
+        std::memcpy(buffer_.get() + buffer_used_, data, copy_size);
+        buffer_used_ += copy_size;
+        data += copy_size;
+        size -= copy_size;
+        if (buffer_used_ == buffer_capacity_ && !FlushBuffer(false)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool DiskStorage::Flush() {
+    return !buffer_ || FlushBuffer(true);
+}
+
+bool DiskStorage::Sync(bool data_only) {
+    if (fd_ < 0 || !Flush()) {
+        return false;
+    }
+    return (data_only ? ::fdatasync(fd_) : ::fsync(fd_)) == 0;
+}
+
+void DiskStorage::Advise(AccessPattern pattern) const {
+    if (fd_ < 0) {
+        return;
+    }
+    int advice = POSIX_FADV_NORMAL;
+    if (pattern == kSequentialAccess) {
+        advice = POSIX_FADV_SEQUENTIAL;
+    } else if (pattern == kRandomAccess) {
+        advice = POSIX_FADV_RANDOM;
+    }
+    ::posix_fadvise(fd_, 0, 0, advice);
+}
+
+void DiskStorage::Readahead(uint64_t offset, size_t size) const {
+    if (fd_ >= 0) {
+        ::posix_fadvise(fd_, static_cast<off_t>(offset), static_cast<off_t>(size), POSIX_FADV_WILLNEED);
+    }
+}
+
+void DiskStorage::DropCache(uint64_t offset, size_t size) const {
+    if (fd_ >= 0) {
+        ::posix_fadvise(fd_, static_cast<off_t>(offset), static_cast<off_t>(size), POSIX_FADV_DONTNEED);
+    }
+}
+
+bool DiskStorage::FlushBuffer(bool all) {
+    if (all && direct_io_ && buffer_used_ % kAlignment != 0 && !DisableDirectIO()) {
+        return false;
+    }
+    size_t write_size = direct_io_ ? buffer_used_ / kAlignment * kAlignment : buffer_used_;
+    if (write_size == 0) {
+        return true;
+    }
+    bool ok = PwriteAll(fd_, append_offset_, buffer_.get(), write_size);
+    if (!ok && direct_io_ && errno == EINVAL && DisableDirectIO()) {       // 打开成功但是写入时才发现不支持
+        ok = PwriteAll(fd_, append_offset_, buffer_.get(), write_size);
+    }
+    if (!ok) {
+        return false;
+    }
+    append_offset_ += write_size;
+    buffer_used_ -= write_size;
+    // direct_io_模式下只有末尾不足一块的部分留在缓冲区中
+    std::memmove(buffer_.get(), buffer_.get() + write_size, buffer_used_);
+    return !options_.sync_on_write_ || ::fdatasync(fd_) == 0;
+}
+
+bool DiskStorage::DisableDirectIO() {
+    if (!direct_io_) {
+        return true;
+    }
+    int flags = ::fcntl(fd_, F_GETFL);
+    if (flags < 0 || ::fcntl(fd_, F_SETFL, flags & ~O_DIRECT) != 0) {
+        return false;
+    }
+    direct_io_ = false;
+    return true;
+}
@@ -5,29 +5,121 @@
 #ifndef KVSTORE_DISKSTORAGE_H
 #define KVSTORE_DISKSTORAGE_H
 
-#include <iostream>
-#include <fstream>
+#include <cstdint>
+#include <cstdlib>
+#include <memory>
+#include <string>
 
 namespace kvstore {
 
-    inline void ReadUint64(std::ifstream &ifs, uint64_t &value) {
-        ifs.read(reinterpret_cast<char*>(value), sizeof(uint64_t));
-    }
-
-    inline void WriteUint64(std::ofstream &ofs, uint64_t value) {
-        ofs.write(reinterpret_cast<char *>(&value), sizeof(uint64_t));
-    }
+    // 文件访问模式的提示,通过posix_fadvise传给内核
+    enum AccessPattern {
+        kNormalAccess = 0,
+        kSequentialAccess = 1,      // 加大内核的预读窗口,适合扫描整个文件
+        kRandomAccess = 2,          // 关闭内核的预读,点查只读取需要的block
+    };
 
-    inline void WriteString(std::ofstream &ofs, const std::string &str) {
-        ofs.write(str.c_str(), str.size());
-    }
+    struct FileOptions {
+        // 追加写时使用O_DIRECT绕过page cache,文件系统不支持时退回到普通的写入.
+        // 写缓冲区的地址,每次写入的长度和偏移都按kAlignment对齐,文件末尾不足一块的部分在Flush时关闭O_DIRECT之后写入
+        bool direct_io_{false};
+        size_t buffer_size_{1024 * 1024};       // 追加写的缓冲区大小,按kAlignment向上对齐
+        bool sync_on_write_{false};             // 写缓冲区每次写入文件之后都fdatasync,脏页不会堆积
+        AccessPattern access_pattern_{kNormalAccess};
+    };
 
+    // 基于pread/pwrite的文件,读写都指定偏移,不改变文件偏移,ReadAt可以被多个线程同时调用.
+    // Append先写入对齐的缓冲区,缓冲区满了才写入文件;析构或者Close时没有Flush的数据被丢弃
     class DiskStorage {
     public:
         static constexpr const uint64_t BLOCK_SIZE = 4 * 1024;
+
+        static constexpr size_t kAlignment = BLOCK_SIZE;        // O_DIRECT要求的对齐,不小于常见设备的逻辑块大小
+
+        DiskStorage() = default;
+
+        ~DiskStorage();
+
+        DiskStorage(const DiskStorage &file) = delete;
+
+        DiskStorage& operator=(const DiskStorage &file) = delete;
+
+        // 以只读方式打开已经存在的文件
+        bool OpenForRead(const std::string &path, const FileOptions &options = FileOptions());
+
+        // 以读写方式打开,不存在时创建,truncate为true时清空已有的内容.追加写从文件末尾开始
+        bool OpenForWrite(const std::string &path, bool truncate, const FileOptions &options = FileOptions());
+
+        bool Close();
+
+        bool IsOpen() const {
+            return fd_ >= 0;
+        }
+
+        int GetFd() const {
+            return fd_;
+        }
+
+        // 当前的文件大小,不包括还在写缓冲区中的部分
+        uint64_t Size() const;
+
+        bool ReadAt(uint64_t offset, size_t size, char *buf) const;
+
+        // 不经过写缓冲区直接写入,direct_io_模式下只用于追加写,这里总是普通的写入
+        bool WriteAt(uint64_t offset, const char *data, size_t size);
+
+        bool Append(const char *data, size_t size);
+
+        bool Append(const std::string &data) {
+            return Append(data.data(), data.size());
+        }
+
+        // 已经追加的字节数,包括还在写缓冲区中的部分
+        uint64_t GetAppendOffset() const {
+            return append_offset_ + buffer_used_;
+        }
+
+        // 把写缓冲区中的所有数据写入文件
+        bool Flush();
+
+        // Flush之后fsync,data_only为true时使用fdatasync
+        bool Sync(bool data_only = false);
+
+        void Advise(AccessPattern pattern) const;
+
+        // 异步地把[offset, offset + size)读进page cache,之后的pread不需要等待磁盘
+        void Readahead(uint64_t offset, size_t size) const;
+
+        // 把[offset, offset + size)从page cache中丢弃,size为0时表示到文件末尾
+        void DropCache(uint64_t offset, size_t size) const;
+
+        bool IsDirectIO() const {
+            return direct_io_;
+        }
+
     private:
-    };
+        struct FreeDeleter {
+            void operator()(char *buffer) const {
+                std::free(buffer);
+            }
+        };
+
+        bool Open(const std::string &path, int flags, const FileOptions &options);
 
+        // 写出缓冲区中对齐的部分,all为true时连同末尾不对齐的部分一起写出
+        bool FlushBuffer(bool all);
+
+        // 不对齐的写入需要先关闭O_DIRECT
+        bool DisableDirectIO();
+
+        int fd_{-1};
+        FileOptions options_;
+        bool direct_io_{false};
+        std::unique_ptr<char, FreeDeleter> buffer_;
+        size_t buffer_capacity_{0};
+        size_t buffer_used_{0};
+        uint64_t append_offset_{0};     // 写缓冲区中的数据在文件中的起始位置
+    };
 
 }
 
@@ -0,0 +1,118 @@
+//
+// Created by 杨丰硕 on 2023/3/24.
+//
+#include "Format.h"
+#include "Coding.h"
+#include "Crc32c.h"
+
+using namespace kvstore;
+
+constexpr uint64_t Footer::kTableMagic;
+constexpr size_t Footer::kEncodedSize;
+
+void kvstore::EncodeIndex(BlockFormat format, const std::vector<uint64_t> &keys,
+                          const std::vector<BlockHandle> &handles, std::string *dst) {
+    uint64_t prev_key = 0, prev_end = 0;
+    for (size_t i = 0; i < keys.size(); ++i) {
+        if (format == kRawFormat) {
+            PutFixed64(dst, keys[i]);
+            PutFixed64(dst, handles[i].offset_);
+            PutFixed64(dst, handles[i].size_);
+            continue;
+        }
+        // block是连续写入的,offset的差值通常是0
+        PutVarint64(dst, keys[i] - prev_key);
+        PutVarint64(dst, handles[i].offset_ - prev_end);
+        PutVarint64(dst, handles[i].size_);
+        prev_key = keys[i];
+        prev_end = handles[i].offset_ + handles[i].size_;
+    }
+}
+
+bool kvstore::DecodeIndex(BlockFormat format, const Slice &index,
+                          std::vector<uint64_t> *keys, std::vector<BlockHandle> *handles) {
+    keys->clear();
+    handles->clear();
+    if (format == kRawFormat) {
+        if (index.size_ % kRawIndexEntrySize != 0) {
+            return false;
+        }
+        size_t block_cnt = index.size_ / kRawIndexEntrySize;
+        keys->resize(block_cnt);
+        handles->resize(block_cnt);
+        for (size_t i = 0; i < block_cnt; ++i) {
+            const char *entry = index.data_ + i * kRawIndexEntrySize;
+            (*keys)[i] = DecodeFixed64(entry);
+            (*handles)[i].offset_ = DecodeFixed64(entry + sizeof(uint64_t));
+            (*handles)[i].size_ = DecodeFixed64(entry + sizeof(uint64_t) * 2);
+        }
+        return true;
+    }
+    const char *p = index.data_, *limit = index.data_ + index.size_;
+    uint64_t key = 0, prev_end = 0;
+    while (p < limit) {
+        uint64_t key_delta, offset_delta, size;
+        p = GetVarint64(p, limit, &key_delta);
+        p = p ? GetVarint64(p, limit, &offset_delta) : nullptr;
+        p = p ? GetVarint64(p, limit, &size) : nullptr;
+        if (!p) {
+            return false;
+        }
+        key += key_delta;
+        keys->push_back(key);
+        handles->push_back(BlockHandle{prev_end + offset_delta, size});
+        prev_end += offset_delta + size;
+    }
+    keys->shrink_to_fit();
+    handles->shrink_to_fit();
+    return true;
+}
+
+void Footer::EncodeTo(std::string *dst) const {
+    std::string footer;
+    PutFixed64(&footer, index_offset_);
+    PutFixed64(&footer, index_size_);
+    PutFixed64(&footer, filter_offset_);
+    PutFixed64(&footer, filter_size_);
+    PutFixed64(&footer, model_offset_);
+    PutFixed64(&footer, model_size_);
+    PutFixed64(&footer, entry_cnt_);
+    PutFixed64(&footer, smallest_key_);
+    PutFixed64(&footer, format_);
+    PutFixed32(&footer, meta_crc_);
+    PutFixed32(&footer, Crc32c(footer.data(), footer.size()));
+    PutFixed64(&footer, kTableMagic);
+    dst->append(footer);
+}
+
+bool Footer::DecodeFrom(const char *data, uint64_t footer_offset) {
+    const size_t field_cnt = 9, crc_offset = field_cnt * sizeof(uint64_t);
+    uint64_t fields[field_cnt];
+    for (size_t i = 0; i < field_cnt; ++i) {
+        fields[i] = DecodeFixed64(data + i * sizeof(uint64_t));
+    }
+    uint64_t magic = DecodeFixed64(data + kEncodedSize - sizeof(uint64_t));
+    uint32_t footer_crc = DecodeFixed32(data + crc_offset + sizeof(uint32_t));
+    if (magic != kTableMagic || footer_crc != Crc32c(data, crc_offset + sizeof(uint32_t))) {
+        return false;
+    }
+    uint64_t format = fields[8];
+    // 各部分依次是filter,learned index和index,最后紧接着footer
+    if ((format != kRawFormat && format != kCompactFormat)
+        || (format == kRawFormat && fields[1] % kRawIndexEntrySize != 0)
+        || fields[0] + fields[1] != footer_offset || fields[2] + fields[3] > fields[4]
+        || fields[4] + fields[5] > fields[0]) {
+        return false;
+    }
+    index_offset_ = fields[0];
+    index_size_ = fields[1];
+    filter_offset_ = fields[2];
+    filter_size_ = fields[3];
+    model_offset_ = fields[4];
+    model_size_ = fields[5];
+    entry_cnt_ = fields[6];
+    smallest_key_ = fields[7];
+    format_ = static_cast<BlockFormat>(format);
+    meta_crc_ = DecodeFixed32(data + crc_offset);
+    return true;
+}
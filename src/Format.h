@@ -0,0 +1,71 @@
+//
+// Created by 杨丰硕 on 2023/3/24.
+//
+
+#ifndef KVSTORE_FORMAT_H
+#define KVSTORE_FORMAT_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "Slice.h"
+
+namespace kvstore {
+
+    // SSTable的格式版本,同一个文件中的data block和index使用相同的编码方式
+    enum BlockFormat : uint64_t {
+        kRawFormat = 1,         // key和offset都是定长的8字节
+        kCompactFormat = 2,     // key和offset按差值做varint编码,每隔固定个数的entry设置一个restart point
+    };
+
+    // block在文件中的位置,size_包括block头部和尾部
+    struct BlockHandle {
+        uint64_t offset_;
+        uint64_t size_;
+    };
+
+    // 文件中每个data block前面有1字节的头部,记录block的CompressionType
+    constexpr size_t kBlockHeaderSize = 1;
+
+    // 每个data block后面有4字节的尾部,记录头部和压缩之后的内容的CRC32C
+    constexpr size_t kBlockTrailerSize = sizeof(uint32_t);
+
+    // kRawFormat下index中每一项的长度,依次是block的最后一个key,block的起始位置和长度
+    constexpr size_t kRawIndexEntrySize = sizeof(uint64_t) * 3;
+
+    // kCompactFormat下每一项分别是和上一项的key的差值,和上一个block结尾的距离以及长度的varint
+    void EncodeIndex(BlockFormat format, const std::vector<uint64_t> &keys,
+                     const std::vector<BlockHandle> &handles, std::string *dst);
+
+    bool DecodeIndex(BlockFormat format, const Slice &index,
+                     std::vector<uint64_t> *keys, std::vector<BlockHandle> *handles);
+
+    // 文件末尾定长的footer,依次是index的起始位置和长度,filter的起始位置和长度,
+    // learned index的起始位置和长度,entry数量,最小的key,格式版本,filter到index整个区域的CRC32C,
+    // footer前面所有字段的CRC32C和magic number.最大的key就是index中最后一个key
+    struct Footer {
+        static constexpr uint64_t kTableMagic = 0x6b76737374616270ULL;     // 增加最小的key时修改过
+
+        static constexpr size_t kEncodedSize = sizeof(uint64_t) * 10 + sizeof(uint32_t) * 2;
+
+        uint64_t index_offset_{0};
+        uint64_t index_size_{0};
+        uint64_t filter_offset_{0};
+        uint64_t filter_size_{0};
+        uint64_t model_offset_{0};
+        uint64_t model_size_{0};        // 为0时没有learned index
+        uint64_t entry_cnt_{0};
+        uint64_t smallest_key_{0};
+        BlockFormat format_{kRawFormat};
+        uint32_t meta_crc_{0};      // filter,learned index和index在文件中是连续的,一起校验
+
+        void EncodeTo(std::string *dst) const;
+
+        // footer_offset是footer在文件中的位置,用来检查index,filter和learned index的位置是否合法,
+        // footer自身的校验和不匹配时也返回false
+        bool DecodeFrom(const char *data, uint64_t footer_offset);
+    };
+
+}
+
+#endif //KVSTORE_FORMAT_H
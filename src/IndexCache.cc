@@ -0,0 +1,92 @@
+//
+// Created by 杨丰硕 on 2023/4/2.
+//
+#include "IndexCache.h"
+
+using namespace kvstore;
+
+IndexCache::IndexCache(size_t capacity, int shard_bits): capacity_(capacity) {
+    size_t shard_cnt = static_cast<size_t>(1) << shard_bits;
+    size_t shard_capacity = (capacity + shard_cnt - 1) / shard_cnt;
+    shards_.reserve(shard_cnt);
+    for (size_t i = 0; i < shard_cnt; ++i) {
+        shards_.emplace_back(new LRUShard(shard_capacity));
+    }
+}
+
+IndexCache::Index IndexCache::Lookup(uint64_t table_id) {
+    return GetShard(table_id).Lookup(table_id);
+}
+
+void IndexCache::Insert(uint64_t table_id, Index index, size_t charge) {
+    GetShard(table_id).Insert(table_id, std::move(index), charge);
+}
+
+void IndexCache::Erase(uint64_t table_id) {
+    GetShard(table_id).Erase(table_id);
+}
+
+size_t IndexCache::GetUsage() const {
+    size_t usage = 0;
+    for (auto &shard : shards_) {
+        usage += shard->GetUsage();
+    }
+    return usage;
+}
+
+size_t IndexCache::GetEntryCount() const {
+    size_t count = 0;
+    for (auto &shard : shards_) {
+        count += shard->GetEntryCount();
+    }
+    return count;
+}
+
+IndexCache::Index IndexCache::LRUShard::Lookup(uint64_t table_id) {
+    std::lock_guard<std::mutex> guard(mutex_);
+    auto findit = table_.find(table_id);
+    if (findit == table_.end()) {
+        return nullptr;
+    }
+    lru_.splice(lru_.begin(), lru_, findit->second);        // 移动到头部
+    return findit->second->index_;
+}
+
+void IndexCache::LRUShard::Insert(uint64_t table_id, Index index, size_t charge) {
+    std::lock_guard<std::mutex> guard(mutex_);
+    auto findit = table_.find(table_id);
+    if (findit != table_.end()) {
+        EraseEntry(findit->second);
+    }
+    usage_ += charge;
+    lru_.push_front(Entry{table_id, std::move(index), charge});
+    table_[table_id] = lru_.begin();
+
+    while (usage_ > capacity_ && lru_.size() > 1) {      // 从尾部淘汰,刚插入的索引至少保留
+        EraseEntry(std::prev(lru_.end()));
+    }
+}
+
+void IndexCache::LRUShard::Erase(uint64_t table_id) {
+    std::lock_guard<std::mutex> guard(mutex_);
+    auto findit = table_.find(table_id);
+    if (findit != table_.end()) {
+        EraseEntry(findit->second);
+    }
+}
+
+void IndexCache::LRUShard::EraseEntry(EntryList::iterator it) {
+    usage_ -= it->charge_;
+    table_.erase(it->table_id_);
+    lru_.erase(it);
+}
+
+size_t IndexCache::LRUShard::GetUsage() const {
+    std::lock_guard<std::mutex> guard(mutex_);
+    return usage_;
+}
+
+size_t IndexCache::LRUShard::GetEntryCount() const {
+    std::lock_guard<std::mutex> guard(mutex_);
+    return lru_.size();
+}
@@ -0,0 +1,95 @@
+//
+// Created by 杨丰硕 on 2023/4/2.
+//
+
+#ifndef KVSTORE_INDEXCACHE_H
+#define KVSTORE_INDEXCACHE_H
+
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+namespace kvstore {
+    struct TableIndex;
+
+    // 被所有SSTable共享的filter和index缓存,按table_id分片,每个分片是一个独立加锁的LRU.
+    // 总大小超过容量时淘汰最久没有使用的表的索引,被淘汰的索引在使用者释放shared_ptr之前仍然有效,
+    // 之后再访问这个表时重新从文件中加载.一个表的索引比一个block大得多,默认的分片数比BlockCache少.
+    // 共享同一个缓存的SSTable的table_id必须互不相同
+    class IndexCache {
+    public:
+        using Index = std::shared_ptr<const TableIndex>;
+
+        explicit IndexCache(size_t capacity, int shard_bits = 2);
+
+        ~IndexCache() = default;
+
+        IndexCache(const IndexCache &cache) = delete;
+
+        IndexCache& operator=(const IndexCache &cache) = delete;
+
+        // 没有命中时返回nullptr
+        Index Lookup(uint64_t table_id);
+
+        // charge是索引占用的内存
+        void Insert(uint64_t table_id, Index index, size_t charge);
+
+        // SSTable析构时调用,立即释放它的索引
+        void Erase(uint64_t table_id);
+
+        size_t GetCapacity() const {
+            return capacity_;
+        }
+
+        size_t GetUsage() const;
+
+        // 缓存中的表的数量
+        size_t GetEntryCount() const;
+
+    private:
+        class LRUShard {
+        public:
+            explicit LRUShard(size_t capacity): capacity_(capacity) {}
+
+            Index Lookup(uint64_t table_id);
+
+            void Insert(uint64_t table_id, Index index, size_t charge);
+
+            void Erase(uint64_t table_id);
+
+            size_t GetUsage() const;
+
+            size_t GetEntryCount() const;
+
+        private:
+            struct Entry {
+                uint64_t table_id_;
+                Index index_;
+                size_t charge_;
+            };
+
+            using EntryList = std::list<Entry>;
+
+            void EraseEntry(EntryList::iterator it);
+
+            mutable std::mutex mutex_;
+            EntryList lru_;     // 头部是最近被使用的
+            std::unordered_map<uint64_t, EntryList::iterator> table_;
+            size_t capacity_;
+            size_t usage_{0};
+        };
+
+        LRUShard &GetShard(uint64_t table_id) {
+            return *shards_[(table_id * 0x9e3779b97f4a7c15ULL >> 32) & (shards_.size() - 1)];
+        }
+
+        size_t capacity_;
+        std::vector<std::unique_ptr<LRUShard>> shards_;
+    };
+
+}
+
+#endif //KVSTORE_INDEXCACHE_H
@@ -0,0 +1,140 @@
+//
+// Created by 杨丰硕 on 2023/3/29.
+//
+#include <algorithm>
+#include <cassert>
+#include "Iterator.h"
+
+using namespace kvstore;
+
+namespace {
+
+    // 用最小堆维护所有有效的child,堆顶是key最小的child,key相同时是最新的child
+    class MergingIterator: public Iterator {
+    public:
+        explicit MergingIterator(std::vector<std::unique_ptr<Iterator>> children): children_(std::move(children)) {
+            heap_.reserve(children_.size());
+        }
+
+        bool Valid() const override {
+            return !heap_.empty();
+        }
+
+        void SeekToFirst() override {
+            for (auto &child : children_) {
+                child->SeekToFirst();
+            }
+            RebuildHeap();
+        }
+
+        void Seek(uint64_t key) override {
+            for (auto &child : children_) {
+                child->Seek(key);
+            }
+            RebuildHeap();
+        }
+
+        void Next() override {
+            assert(Valid());
+            // 当前key在较旧的child中的记录都已经过时,一起跳过
+            uint64_t key = Key();
+            while (!heap_.empty() && children_[heap_.front()]->Key() == key) {
+                std::pop_heap(heap_.begin(), heap_.end(), HeapCompare());
+                size_t child = heap_.back();
+                heap_.pop_back();
+                children_[child]->Next();
+                if (children_[child]->Valid()) {
+                    heap_.push_back(child);
+                    std::push_heap(heap_.begin(), heap_.end(), HeapCompare());
+                }
+            }
+        }
+
+        uint64_t Key() const override {
+            return children_[heap_.front()]->Key();
+        }
+
+        Slice Value() const override {
+            return children_[heap_.front()]->Value();
+        }
+
+        bool Ok() const override {
+            return std::all_of(children_.begin(), children_.end(),
+                               [](const std::unique_ptr<Iterator> &child) { return child->Ok(); });
+        }
+
+    private:
+        struct Greater {
+            const MergingIterator *iter_;
+
+            bool operator()(size_t a, size_t b) const {
+                uint64_t key_a = iter_->children_[a]->Key(), key_b = iter_->children_[b]->Key();
+                return key_a > key_b || (key_a == key_b && a > b);
+            }
+        };
+
+        Greater HeapCompare() const {
+            return Greater{this};
+        }
+
+        void RebuildHeap() {
+            heap_.clear();
+            for (size_t i = 0; i < children_.size(); ++i) {
+                if (children_[i]->Valid()) {
+                    heap_.push_back(i);
+                }
+            }
+            std::make_heap(heap_.begin(), heap_.end(), HeapCompare());
+        }
+
+        std::vector<std::unique_ptr<Iterator>> children_;
+        std::vector<size_t> heap_;      // children_中的下标
+    };
+
+    class VectorIterator: public Iterator {
+    public:
+        explicit VectorIterator(std::vector<std::pair<uint64_t, std::string>> kvs):
+                kvs_(std::move(kvs)), pos_(kvs_.size()) {}
+
+        bool Valid() const override {
+            return pos_ < kvs_.size();
+        }
+
+        void SeekToFirst() override {
+            pos_ = 0;
+        }
+
+        void Seek(uint64_t key) override {
+            pos_ = std::lower_bound(kvs_.begin(), kvs_.end(), key,
+                                    [](const std::pair<uint64_t, std::string> &kv, uint64_t k) {
+                                        return kv.first < k;
+                                    }) - kvs_.begin();
+        }
+
+        void Next() override {
+            assert(Valid());
+            ++pos_;
+        }
+
+        uint64_t Key() const override {
+            return kvs_[pos_].first;
+        }
+
+        Slice Value() const override {
+            return Slice(kvs_[pos_].second);
+        }
+
+    private:
+        std::vector<std::pair<uint64_t, std::string>> kvs_;
+        size_t pos_;
+    };
+
+}
+
+std::unique_ptr<Iterator> kvstore::NewMergingIterator(std::vector<std::unique_ptr<Iterator>> children) {
+    return std::unique_ptr<Iterator>(new MergingIterator(std::move(children)));
+}
+
+std::unique_ptr<Iterator> kvstore::NewVectorIterator(std::vector<std::pair<uint64_t, std::string>> kvs) {
+    return std::unique_ptr<Iterator>(new VectorIterator(std::move(kvs)));
+}
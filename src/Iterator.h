@@ -0,0 +1,56 @@
+//
+// Created by 杨丰硕 on 2023/3/29.
+//
+
+#ifndef KVSTORE_ITERATOR_H
+#define KVSTORE_ITERATOR_H
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+#include "Slice.h"
+
+namespace kvstore {
+
+    // 按key递增的顺序遍历kv,创建之后需要先调用SeekToFirst或者Seek.
+    // Value返回的Slice在下一次移动迭代器之前有效
+    class Iterator {
+    public:
+        Iterator() = default;
+
+        virtual ~Iterator() = default;
+
+        Iterator(const Iterator &iterator) = delete;
+
+        Iterator& operator=(const Iterator &iterator) = delete;
+
+        virtual bool Valid() const = 0;
+
+        virtual void SeekToFirst() = 0;
+
+        // 定位到第一个不小于key的位置
+        virtual void Seek(uint64_t key) = 0;
+
+        virtual void Next() = 0;
+
+        virtual uint64_t Key() const = 0;
+
+        virtual Slice Value() const = 0;
+
+        // 读取数据失败时返回false,此时迭代器会停止,Valid也返回false
+        virtual bool Ok() const {
+            return true;
+        }
+    };
+
+    // children从新到旧排列,同一个key只返回最新的child中的记录,其余的被跳过
+    std::unique_ptr<Iterator> NewMergingIterator(std::vector<std::unique_ptr<Iterator>> children);
+
+    // kvs必须已经按key严格递增排好序
+    std::unique_ptr<Iterator> NewVectorIterator(std::vector<std::pair<uint64_t, std::string>> kvs);
+
+}
+
+#endif //KVSTORE_ITERATOR_H
@@ -0,0 +1,172 @@
+//
+// Created by 杨丰硕 on 2023/3/26.
+//
+#include <algorithm>
+#include <cassert>
+#include "KeySearch.h"
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define KVSTORE_X86 1
+#endif
+
+using namespace kvstore;
+
+constexpr size_t KeySearcher::kNodeKeys;
+
+bool KeySearcher::HasAvx2() {
+#ifdef KVSTORE_X86
+    static const bool has_avx2 = __builtin_cpu_supports("avx2");
+    return has_avx2;
+#else
+    return false;
+#endif
+}
+
+void KeySearcher::Build(const std::vector<uint64_t> &keys, SearchLayout layout) {
+    assert(keys.size() < UINT32_MAX);
+    if (layout == kAutoLayout) {
+        layout = HasAvx2() ? kBTreeLayout : kEytzingerLayout;
+    }
+    layout_ = layout;
+    size_ = keys.size();
+    use_avx2_ = layout_ == kBTreeLayout && HasAvx2();
+    keys_.clear();
+    ranks_.clear();
+    layer_offsets_.clear();
+    node_offset_ = 0;
+    size_t rank = 0;
+    switch (layout_) {
+        case kSortedLayout:
+            keys_ = keys;
+            break;
+        case kEytzingerLayout:
+            // 下标从1开始,k的子结点是2k和2k + 1
+            keys_.resize(size_ + 1);
+            ranks_.resize(size_ + 1);
+            BuildEytzinger(keys, 1, &rank);
+            break;
+        default:
+            BuildBTree(keys);
+            break;
+    }
+    assert(layout_ != kEytzingerLayout || rank == size_);
+}
+
+size_t KeySearcher::LowerBound(uint64_t key) const {
+    switch (layout_) {
+        case kSortedLayout:
+            return SortedLowerBound(key);
+        case kEytzingerLayout:
+            return EytzingerLowerBound(key);
+        default:
+            return use_avx2_ ? BTreeLowerBoundAvx2(key) : BTreeLowerBound(key);
+    }
+}
+
+void KeySearcher::BuildEytzinger(const std::vector<uint64_t> &keys, size_t k, size_t *rank) {
+    if (k > size_) {
+        return;
+    }
+    // 中序遍历完全二叉树时依次填入有序的key
+    BuildEytzinger(keys, k * 2, rank);
+    keys_[k] = keys[*rank];
+    ranks_[k] = static_cast<uint32_t>(*rank);
+    ++*rank;
+    BuildEytzinger(keys, k * 2 + 1, rank);
+}
+
+void KeySearcher::BuildBTree(const std::vector<uint64_t> &keys) {
+    if (size_ == 0) {
+        return;
+    }
+    std::vector<size_t> layer_nodes{(size_ + kNodeKeys - 1) / kNodeKeys};
+    while (layer_nodes.back() > 1) {
+        layer_nodes.push_back((layer_nodes.back() + kNodeKeys) / (kNodeKeys + 1));
+    }
+    size_t total_keys = 0;
+    for (size_t nodes : layer_nodes) {
+        layer_offsets_.push_back(total_keys);
+        total_keys += nodes * kNodeKeys;
+    }
+    // 多分配一个cache line用来对齐,不足的位置用UINT64_MAX填充
+    keys_.assign(total_keys + kNodeKeys, UINT64_MAX);
+    node_offset_ = (64 - reinterpret_cast<uintptr_t>(keys_.data()) % 64) % 64 / sizeof(uint64_t);
+    uint64_t *leaves = Nodes();
+    std::copy(keys.begin(), keys.end(), leaves);
+    // 第h层结点m的第j个key是第j + 1个子树中最小的key,也就是这个子树最左边的叶子结点的第一个key
+    size_t leaves_per_child = 1;
+    for (size_t h = 1; h < layer_nodes.size(); ++h) {
+        uint64_t *layer = Nodes() + layer_offsets_[h];
+        for (size_t m = 0; m < layer_nodes[h]; ++m) {
+            for (size_t j = 0; j < kNodeKeys; ++j) {
+                size_t leaf = (m * (kNodeKeys + 1) + j + 1) * leaves_per_child;
+                if (leaf < layer_nodes[0]) {
+                    layer[m * kNodeKeys + j] = leaves[leaf * kNodeKeys];
+                }
+            }
+        }
+        leaves_per_child *= kNodeKeys + 1;
+    }
+}
+
+size_t KeySearcher::SortedLowerBound(uint64_t key) const {
+    return std::lower_bound(keys_.begin(), keys_.end(), key) - keys_.begin();
+}
+
+size_t KeySearcher::EytzingerLowerBound(uint64_t key) const {
+    const uint64_t *keys = keys_.data();
+    size_t k = 1;
+    while (k <= size_) {
+        // 4层之后的16个后代是连续的,提前把它们所在的cache line取进来
+        __builtin_prefetch(keys + k * 16);
+        k = k * 2 + (keys[k] < key);
+    }
+    // 去掉最后一段向右走的路径,剩下的就是最后一次向左走的结点
+    k >>= __builtin_ffsll(static_cast<long long>(~k));
+    return k == 0 ? size_ : ranks_[k];
+}
+
+size_t KeySearcher::BTreeLowerBound(uint64_t key) const {
+    if (size_ == 0) {
+        return 0;
+    }
+    const uint64_t *nodes = Nodes();
+    size_t node = 0;
+    for (size_t h = layer_offsets_.size(); h-- > 0;) {
+        const uint64_t *curr = nodes + layer_offsets_[h] + node * kNodeKeys;
+        size_t i = 0;
+        for (size_t j = 0; j < kNodeKeys; ++j) {        // 没有分支的计数,编译器可以展开
+            i += curr[j] < key;
+        }
+        node = h > 0 ? node * (kNodeKeys + 1) + i : node * kNodeKeys + i;
+    }
+    return std::min(node, size_);
+}
+
+#ifdef KVSTORE_X86
+__attribute__((target("avx2")))
+size_t KeySearcher::BTreeLowerBoundAvx2(uint64_t key) const {
+    if (size_ == 0) {
+        return 0;
+    }
+    // AVX2只有有符号的64位比较,两边都翻转符号位之后等价于无符号比较
+    const __m256i flip = _mm256_set1_epi64x(INT64_MIN);
+    const __m256i target = _mm256_xor_si256(_mm256_set1_epi64x(static_cast<long long>(key)), flip);
+    const uint64_t *nodes = Nodes();
+    size_t node = 0;
+    for (size_t h = layer_offsets_.size(); h-- > 0;) {
+        const uint64_t *curr = nodes + layer_offsets_[h] + node * kNodeKeys;
+        __m256i low = _mm256_xor_si256(_mm256_load_si256(reinterpret_cast<const __m256i *>(curr)), flip);
+        __m256i high = _mm256_xor_si256(_mm256_load_si256(reinterpret_cast<const __m256i *>(curr + 4)), flip);
+        int low_mask = _mm256_movemask_pd(_mm256_castsi256_pd(_mm256_cmpgt_epi64(target, low)));
+        int high_mask = _mm256_movemask_pd(_mm256_castsi256_pd(_mm256_cmpgt_epi64(target, high)));
+        size_t i = __builtin_popcount(static_cast<unsigned>(low_mask | (high_mask << 4)));
+        node = h > 0 ? node * (kNodeKeys + 1) + i : node * kNodeKeys + i;
+    }
+    return std::min(node, size_);
+}
+#else
+size_t KeySearcher::BTreeLowerBoundAvx2(uint64_t key) const {
+    return BTreeLowerBound(key);
+}
+#endif
@@ -0,0 +1,93 @@
+//
+// Created by 杨丰硕 on 2023/3/26.
+//
+
+#ifndef KVSTORE_KEYSEARCH_H
+#define KVSTORE_KEYSEARCH_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace kvstore {
+
+    // 有序key数组在内存中的布局
+    enum SearchLayout {
+        kSortedLayout = 0,      // 原始的有序数组,std::lower_bound的方式二分查找
+        kEytzingerLayout = 1,   // 按照完全二叉树的BFS顺序排列,查找路径上的结点集中在数组前部,可以提前prefetch
+        kBTreeLayout = 2,       // 每个结点8个key正好一个cache line的静态B+树,支持AVX2时一次比较一个结点
+        kAutoLayout = 3,        // 支持AVX2时使用kBTreeLayout,否则使用kEytzingerLayout
+    };
+
+    // 在有序的uint64_t数组上建立适合查找的布局,LowerBound返回的是在原数组中的下标.
+    // kEytzingerLayout中每个key额外记录一个4字节的下标,key的数量不能超过UINT32_MAX;
+    // kBTreeLayout的叶子层就是原数组,上面每层的结点有9个子结点,不需要额外记录下标
+    class KeySearcher {
+    public:
+        KeySearcher() = default;
+
+        // B树结点的对齐依赖于keys_的地址,拷贝之后会失效,只能移动
+        KeySearcher(const KeySearcher &searcher) = delete;
+
+        KeySearcher& operator=(const KeySearcher &searcher) = delete;
+
+        KeySearcher(KeySearcher &&searcher) = default;
+
+        KeySearcher& operator=(KeySearcher &&searcher) = default;
+
+        void Build(const std::vector<uint64_t> &keys, SearchLayout layout = kAutoLayout);
+
+        // 返回第一个不小于key的下标,都小于key时返回Size()
+        size_t LowerBound(uint64_t key) const;
+
+        SearchLayout GetLayout() const {
+            return layout_;
+        }
+
+        size_t Size() const {
+            return size_;
+        }
+
+        size_t MemoryUsage() const {
+            return keys_.capacity() * sizeof(uint64_t) + ranks_.capacity() * sizeof(uint32_t);
+        }
+
+        // 当前CPU是否支持AVX2,只检测一次
+        static bool HasAvx2();
+
+    private:
+        static constexpr size_t kNodeKeys = 8;      // 64字节,一个cache line
+
+        void BuildEytzinger(const std::vector<uint64_t> &keys, size_t k, size_t *rank);
+
+        void BuildBTree(const std::vector<uint64_t> &keys);
+
+        size_t SortedLowerBound(uint64_t key) const;
+
+        size_t EytzingerLowerBound(uint64_t key) const;
+
+        size_t BTreeLowerBound(uint64_t key) const;
+
+        size_t BTreeLowerBoundAvx2(uint64_t key) const;
+
+        // B树结点按cache line对齐之后的起始位置
+        const uint64_t *Nodes() const {
+            return keys_.data() + node_offset_;
+        }
+
+        uint64_t *Nodes() {
+            return keys_.data() + node_offset_;
+        }
+
+        SearchLayout layout_{kSortedLayout};
+        size_t size_{0};
+        std::vector<uint64_t> keys_;        // 按layout_排列的key
+        std::vector<uint32_t> ranks_;       // kEytzingerLayout下和keys_一一对应的原始下标
+        size_t node_offset_{0};
+        std::vector<size_t> layer_offsets_;     // kBTreeLayout每层在Nodes()中的起始位置,第0层是叶子
+        bool use_avx2_{false};
+    };
+
+}
+
+#endif //KVSTORE_KEYSEARCH_H
@@ -0,0 +1,687 @@
+//
+// Created by 杨丰硕 on 2023/3/15.
+//
+#include <algorithm>
+#include <atomic>
+#include <dirent.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "KvStore.h"
+#include "Manifest.h"
+#include "SSTableBuilder.h"
+
+using namespace kvstore;
+
+constexpr int KvStore::kNumLevels;
+
+namespace {
+
+    bool IsDeletion(const Slice &encoded) {
+        return encoded.Empty() || encoded.data_[0] == kTypeDeletion;
+    }
+
+    // 空表的key范围没有意义,不和任何范围重叠
+    bool Overlaps(const std::shared_ptr<SSTable> &table, uint64_t smallest, uint64_t largest) {
+        return table->GetEntryCount() > 0 && table->GetSmallestKey() <= largest && table->GetLargestKey() >= smallest;
+    }
+
+    uint64_t TotalFileSize(const std::vector<std::shared_ptr<SSTable>> &tables) {
+        uint64_t size = 0;
+        for (auto &table : tables) {
+            size += table->GetFileSize();
+        }
+        return size;
+    }
+
+    bool Contains(const std::vector<std::shared_ptr<SSTable>> &tables, const std::shared_ptr<SSTable> &table) {
+        return std::find(tables.begin(), tables.end(), table) != tables.end();
+    }
+
+    // dir中所有名字是"<table_id>.sst"的文件的table_id
+    std::vector<uint64_t> ListTableFiles(const std::string &dir) {
+        std::vector<uint64_t> table_ids;
+        DIR *dirp = ::opendir(dir.c_str());
+        if (!dirp) {
+            return table_ids;
+        }
+        while (dirent *entry = ::readdir(dirp)) {
+            std::string name = entry->d_name;
+            size_t digits = name.find_first_not_of("0123456789");
+            if (digits > 0 && digits != std::string::npos && name.compare(digits, std::string::npos, ".sst") == 0) {
+                table_ids.push_back(std::stoull(name.substr(0, digits)));
+            }
+        }
+        ::closedir(dirp);
+        return table_ids;
+    }
+
+    // 跳过墓碑并去掉value的类型,pins_持有创建时的memtable和version,保证遍历期间它们有效
+    class StoreIterator: public Iterator {
+    public:
+        StoreIterator(std::vector<std::shared_ptr<const void>> pins, std::unique_ptr<Iterator> iter):
+                pins_(std::move(pins)), iter_(std::move(iter)) {}
+
+        bool Valid() const override {
+            return iter_->Valid();
+        }
+
+        void SeekToFirst() override {
+            iter_->SeekToFirst();
+            SkipDeletions();
+        }
+
+        void Seek(uint64_t key) override {
+            iter_->Seek(key);
+            SkipDeletions();
+        }
+
+        void Next() override {
+            iter_->Next();
+            SkipDeletions();
+        }
+
+        uint64_t Key() const override {
+            return iter_->Key();
+        }
+
+        Slice Value() const override {
+            Slice encoded = iter_->Value();
+            return Slice(encoded.data_ + 1, encoded.size_ - 1);
+        }
+
+        bool Ok() const override {
+            return iter_->Ok();
+        }
+
+    private:
+        void SkipDeletions() {
+            while (iter_->Valid() && IsDeletion(iter_->Value())) {
+                iter_->Next();
+            }
+        }
+
+        std::vector<std::shared_ptr<const void>> pins_;
+        std::unique_ptr<Iterator> iter_;        // 最后声明,最先析构
+    };
+
+}
+
+KvStore::KvStore(const Options &options):
+        options_(options),
+        block_cache_(options.block_cache_size_ > 0 ? new BlockCache(options.block_cache_size_) : nullptr),
+        index_cache_(options.index_cache_size_ > 0 ? new IndexCache(options.index_cache_size_) : nullptr),
+        mem_(std::make_shared<MemTable>(options.use_arena_, options.memtable_hash_index_)),
+        current_(std::make_shared<Version>()) {
+    ::mkdir(options_.dir_.c_str(), 0755);
+    Recover();
+    flush_thread_ = std::thread(&KvStore::BackgroundFlush, this);
+    compaction_thread_ = std::thread(&KvStore::BackgroundCompaction, this);
+}
+
+KvStore::~KvStore() {
+    {
+        std::lock_guard<std::mutex> guard(mutex_);
+        if (mem_->ApproximateMemoryUsage() > 0) {       // 关闭之前把剩下的数据也flush下去
+            FreezeMemTable();
+        }
+        closing_ = true;
+    }
+    flush_cv_.notify_one();
+    compaction_cv_.notify_one();        // 正在进行的合并会先完成
+    flush_thread_.join();
+    compaction_thread_.join();
+}
+
+bool KvStore::Put(const uint64_t &key, const std::string &value) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    return MakeRoomForWrite(lock) && mem_->Put(key, value);
+}
+
+bool KvStore::Get(const uint64_t &key, std::string *value) const {
+    bool deleted = false;
+    std::deque<MemTablePtr> imms;
+    VersionPtr version;
+    {
+        // 只有当前的memtable需要在锁内读取,冻结的memtable和SSTable都是只读的
+        std::lock_guard<std::mutex> guard(mutex_);
+        if (mem_->Get(key, value, &deleted)) {
+            return !deleted;
+        }
+        imms = imms_;
+        version = current_;
+    }
+    for (auto it = imms.rbegin(); it != imms.rend(); ++it) {      // 从新到旧查找
+        if ((*it)->Get(key, value, &deleted)) {
+            return !deleted;
+        }
+    }
+    std::string encoded;
+    auto &level0 = version->levels_[0];
+    for (auto it = level0.rbegin(); it != level0.rend(); ++it) {
+        if ((*it)->Get(key, &encoded, true)) {
+            return DecodeValue(encoded, value);
+        }
+    }
+    // 其他层中最多只有一个SSTable的key范围包含key
+    for (int level = 1; level < kNumLevels; ++level) {
+        auto &tables = version->levels_[level];
+        auto it = std::lower_bound(tables.begin(), tables.end(), key, [](const SSTablePtr &table, uint64_t k) {
+            return table->GetLargestKey() < k;
+        });
+        if (it != tables.end() && (*it)->GetSmallestKey() <= key && (*it)->Get(key, &encoded, true)) {
+            return DecodeValue(encoded, value);
+        }
+    }
+    return false;
+}
+
+bool KvStore::Delete(const uint64_t &key) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    return MakeRoomForWrite(lock) && mem_->Delete(key);
+}
+
+bool KvStore::Write(WriteBatch &batch) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    return MakeRoomForWrite(lock) && mem_->Write(batch);
+}
+
+void KvStore::Dump() {
+    std::lock_guard<std::mutex> guard(mutex_);
+    std::cout << "memtable usage: " << mem_->ApproximateMemoryUsage()
+              << ", immutable memtables: " << imms_.size() << ", sstables:";
+    for (auto &tables : current_->levels_) {
+        std::cout << ' ' << tables.size();
+    }
+    std::cout << '\n';
+}
+
+bool KvStore::Flush() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    if (mem_->ApproximateMemoryUsage() > 0) {
+        FreezeMemTable();
+    }
+    done_cv_.wait(lock, [this]() { return imms_.empty() || flush_error_; });
+    return imms_.empty();
+}
+
+void KvStore::WaitForCompaction() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    ++manual_compaction_cnt_;
+    compaction_cv_.notify_one();
+    done_cv_.wait(lock, [this]() { return (imms_.empty() || flush_error_) && !compacting_ && !NeedsCompaction(); });
+    --manual_compaction_cnt_;
+}
+
+std::unique_ptr<Iterator> KvStore::NewIterator() const {
+    std::vector<std::pair<uint64_t, std::string>> mem_kvs;
+    std::deque<MemTablePtr> imms;
+    VersionPtr version;
+    {
+        // 当前的memtable还在接受写入,只能在锁内拷贝一份
+        std::lock_guard<std::mutex> guard(mutex_);
+        auto mem_iter = mem_->NewIterator();
+        for (mem_iter->SeekToFirst(); mem_iter->Valid(); mem_iter->Next()) {
+            mem_kvs.emplace_back(mem_iter->Key(), mem_iter->Value().ToString());
+        }
+        imms = imms_;
+        version = current_;
+    }
+    std::vector<std::unique_ptr<Iterator>> children;        // 从新到旧
+    std::vector<std::shared_ptr<const void>> pins{version};
+    children.push_back(NewVectorIterator(std::move(mem_kvs)));
+    for (auto it = imms.rbegin(); it != imms.rend(); ++it) {
+        children.push_back((*it)->NewIterator());
+        pins.push_back(*it);
+    }
+    auto &level0 = version->levels_[0];
+    for (auto it = level0.rbegin(); it != level0.rend(); ++it) {
+        children.push_back(NewLevelIterator({*it}));
+    }
+    for (int level = 1; level < kNumLevels; ++level) {
+        if (!version->levels_[level].empty()) {
+            children.push_back(NewLevelIterator(version->levels_[level]));
+        }
+    }
+    return std::unique_ptr<Iterator>(new StoreIterator(std::move(pins), NewMergingIterator(std::move(children))));
+}
+
+size_t KvStore::GetSSTableCount() const {
+    std::lock_guard<std::mutex> guard(mutex_);
+    size_t count = 0;
+    for (auto &tables : current_->levels_) {
+        count += tables.size();
+    }
+    return count;
+}
+
+size_t KvStore::GetLevelTableCount(int level) const {
+    std::lock_guard<std::mutex> guard(mutex_);
+    return current_->levels_[level].size();
+}
+
+CompactionStats KvStore::GetCompactionStats() const {
+    std::lock_guard<std::mutex> guard(mutex_);
+    return compaction_stats_;
+}
+
+size_t KvStore::GetIndexCacheUsage() const {
+    return index_cache_ ? index_cache_->GetUsage() : 0;
+}
+
+void KvStore::Recover() {
+    Manifest manifest;
+    bool recovered = ReadManifest(options_.dir_, &manifest);
+    auto &entries = manifest.entries_;
+    entries.erase(std::remove_if(entries.begin(), entries.end(), [](const ManifestEntry &entry) {
+        return entry.level_ < 0 || entry.level_ >= kNumLevels;
+    }), entries.end());
+    // 打开文件和加载索引都是互相独立的小的同步读,由固定数量的线程从同一个队列中领取
+    std::vector<SSTablePtr> tables(entries.size());
+    std::atomic<size_t> next_entry{0};
+    std::mutex progress_mutex;
+    size_t opened = 0;
+    auto table_options = NewSSTableOptions();
+    auto open_tables = [&]() {
+        for (size_t i = next_entry++; i < entries.size(); i = next_entry++) {
+            auto &entry = entries[i];
+            SSTableId table_id{entry.table_id_, options_.dir_ + "/" + std::to_string(entry.table_id_) + ".sst"};
+            // 只打开文件,不读取footer,filter和index
+            tables[i] = std::make_shared<SSTable>(table_id, entry.properties_, table_options);
+            if (options_.preload_indexes_) {
+                tables[i]->PreloadIndex();
+            }
+            if (options_.open_progress_) {
+                std::lock_guard<std::mutex> guard(progress_mutex);
+                options_.open_progress_(++opened, entries.size());
+            }
+        }
+    };
+    std::vector<std::thread> workers;
+    size_t worker_cnt = std::min(std::max<size_t>(options_.open_threads_, 1), entries.size());
+    for (size_t i = 1; i < worker_cnt; ++i) {
+        workers.emplace_back(open_tables);
+    }
+    open_tables();
+    for (auto &worker : workers) {
+        worker.join();
+    }
+    auto version = std::make_shared<Version>();
+    std::vector<uint64_t> live_ids;
+    for (size_t i = 0; i < entries.size(); ++i) {
+        version->levels_[entries[i].level_].push_back(tables[i]);
+        live_ids.push_back(entries[i].table_id_);
+    }
+    current_ = version;
+    next_table_id_ = manifest.next_table_id_;
+    std::sort(live_ids.begin(), live_ids.end());
+    for (uint64_t table_id : ListTableFiles(options_.dir_)) {
+        // 没有manifest或者manifest损坏时不删除任何文件,只保证新的SSTable不会覆盖它们
+        next_table_id_ = std::max(next_table_id_, table_id + 1);
+        // 没有被manifest引用的文件是崩溃前没有完成的flush或者合并的输出,以及已经被合并掉的输入
+        if (recovered && !std::binary_search(live_ids.begin(), live_ids.end(), table_id)) {
+            ::unlink((options_.dir_ + "/" + std::to_string(table_id) + ".sst").c_str());
+        }
+    }
+}
+
+bool KvStore::MakeRoomForWrite(std::unique_lock<std::mutex> &lock) {
+    if (mem_->ApproximateMemoryUsage() < options_.memtable_size_) {
+        return true;
+    }
+    // flush跟不上写入的速度时才会阻塞在这里
+    done_cv_.wait(lock, [this]() { return imms_.size() < options_.max_immutable_cnt_ || flush_error_; });
+    if (imms_.size() >= options_.max_immutable_cnt_) {      // flush已经停止,不会再有memtable被移除
+        return false;
+    }
+    FreezeMemTable();
+    return true;
+}
+
+void KvStore::FreezeMemTable() {
+    mem_->Freeze();
+    imms_.push_back(mem_);
+    mem_ = std::make_shared<MemTable>(options_.use_arena_, options_.memtable_hash_index_);
+    flush_cv_.notify_one();
+}
+
+SSTableId KvStore::NewSSTableId() {
+    SSTableId table_id;
+    table_id.table_id_ = next_table_id_++;
+    table_id.path_ = options_.dir_ + "/" + std::to_string(table_id.table_id_) + ".sst";
+    return table_id;
+}
+
+bool KvStore::LogAndApply(std::unique_lock<std::mutex> &lock, const std::function<void(Version *)> &edit) {
+    lock.unlock();
+    std::lock_guard<std::mutex> manifest_guard(manifest_mutex_);
+    lock.lock();
+    // 持有manifest_mutex_期间只有这个线程会替换current_,写入的manifest总是最新的版本
+    auto version = std::make_shared<Version>(*current_);
+    edit(version.get());
+    Manifest manifest;
+    manifest.next_table_id_ = next_table_id_;
+    for (int level = 0; level < kNumLevels; ++level) {
+        for (auto &table : version->levels_[level]) {
+            manifest.entries_.push_back(ManifestEntry{level, table->GetId().table_id_, table->GetProperties()});
+        }
+    }
+    lock.unlock();
+    // fsync的过程中不持有锁,前台的读写不受影响
+    bool ok = WriteManifest(options_.dir_, manifest, options_.table_sync_policy_ != kNoSync);
+    lock.lock();
+    if (ok) {
+        current_ = version;
+    }
+    return ok;
+}
+
+void KvStore::BackgroundFlush() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (true) {
+        flush_cv_.wait(lock, [this]() { return closing_ || (!imms_.empty() && !flush_error_); });
+        if (imms_.empty()) {        // 已经关闭并且没有需要flush的memtable了
+            break;
+        }
+        auto imm = imms_.front();
+        auto table_id = NewSSTableId();
+        lock.unlock();
+        // 写文件的过程中不持有锁,前台的读写不受影响
+        auto sstable = std::make_shared<SSTable>(imm->GetTable(), table_id, NewSSTableOptions());
+        lock.lock();
+        // manifest写入失败时不能移除memtable,否则下次启动时这个没有被manifest引用的SSTable会被删除
+        if (!sstable->Ok() || !LogAndApply(lock, [&](Version *version) { version->levels_[0].push_back(sstable); })) {
+            // memtable留在imms_中,数据仍然可读.之后不再自动flush,关闭时再尝试一次
+            sstable->MarkObsolete();
+            flush_error_ = true;
+            done_cv_.notify_all();
+            if (closing_) {
+                break;
+            }
+            continue;
+        }
+        imms_.pop_front();      // SSTable可见之后才能移除对应的memtable
+        done_cv_.notify_all();
+        compaction_cv_.notify_one();
+    }
+}
+
+SSTableOptions KvStore::NewSSTableOptions() const {
+    SSTableOptions table_options;
+    table_options.block_cache_ = block_cache_.get();
+    table_options.use_mmap_ = options_.use_mmap_;
+    table_options.bloom_bits_per_key_ = options_.bloom_bits_per_key_;
+    table_options.format_ = options_.table_format_;
+    table_options.sync_policy_ = options_.table_sync_policy_;
+    table_options.direct_io_ = options_.use_direct_io_for_flush_and_compaction_;
+    table_options.compression_ = options_.table_compression_;
+    table_options.verify_policy_ = options_.table_verify_policy_;
+    table_options.index_cache_ = index_cache_.get();
+    return table_options;
+}
+
+uint64_t KvStore::MaxBytesForLevel(int level) const {
+    uint64_t max_bytes = options_.level1_max_bytes_;
+    for (int i = 1; i < level; ++i) {
+        max_bytes *= options_.level_size_multiplier_;
+    }
+    return max_bytes;
+}
+
+bool KvStore::NeedsCompaction() const {
+    if (compaction_error_) {
+        return false;
+    }
+    if (current_->levels_[0].size() >= std::max<size_t>(options_.level0_compaction_trigger_, 1)) {
+        return true;
+    }
+    // 最后一层没有下一层可以合并
+    for (int level = 1; level + 1 < kNumLevels; ++level) {
+        if (TotalFileSize(current_->levels_[level]) > MaxBytesForLevel(level)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+KvStore::Compaction KvStore::PickCompaction() {
+    Compaction compaction;
+    auto &version = *current_;
+    if (version.levels_[0].size() >= std::max<size_t>(options_.level0_compaction_trigger_, 1)) {
+        compaction.inputs_[0] = version.levels_[0];     // level 0的SSTable互相重叠,全部一起合并
+    } else {
+        for (int level = 1; level + 1 < kNumLevels; ++level) {
+            auto &tables = version.levels_[level];
+            if (TotalFileSize(tables) <= MaxBytesForLevel(level)) {
+                continue;
+            }
+            // 轮流合并这一层的每个SSTable,保证整个key范围都会被合并到
+            auto it = std::find_if(tables.begin(), tables.end(), [&](const SSTablePtr &table) {
+                return table->GetLargestKey() > compact_pointers_[level];
+            });
+            compaction.level_ = level;
+            compaction.inputs_[0].push_back(it == tables.end() ? tables.front() : *it);
+            break;
+        }
+    }
+    uint64_t smallest = UINT64_MAX, largest = 0;
+    for (auto &table : compaction.inputs_[0]) {
+        if (table->GetEntryCount() > 0) {
+            smallest = std::min(smallest, table->GetSmallestKey());
+            largest = std::max(largest, table->GetLargestKey());
+        }
+    }
+    for (auto &table : version.levels_[compaction.level_ + 1]) {
+        if (Overlaps(table, smallest, largest)) {
+            compaction.inputs_[1].push_back(table);
+        }
+    }
+    compaction.bottommost_ = true;
+    for (int level = compaction.level_ + 2; level < kNumLevels; ++level) {
+        for (auto &table : version.levels_[level]) {
+            compaction.bottommost_ = compaction.bottommost_ && !Overlaps(table, smallest, largest);
+        }
+    }
+    return compaction;
+}
+
+bool KvStore::InstallCompaction(std::unique_lock<std::mutex> &lock, const Compaction &compaction,
+                                const std::vector<SSTablePtr> &outputs) {
+    // 等待写manifest期间可能有新flush的SSTable加入level 0,修改的是那时的current_
+    bool ok = LogAndApply(lock, [&](Version *version) {
+        for (int i = 0; i < 2; ++i) {
+            auto &inputs = compaction.inputs_[i];
+            auto &tables = version->levels_[compaction.level_ + i];
+            tables.erase(std::remove_if(tables.begin(), tables.end(), [&](const SSTablePtr &table) {
+                return Contains(inputs, table);
+            }), tables.end());
+        }
+        auto &next_level = version->levels_[compaction.level_ + 1];
+        next_level.insert(next_level.end(), outputs.begin(), outputs.end());
+        std::sort(next_level.begin(), next_level.end(), [](const SSTablePtr &a, const SSTablePtr &b) {
+            return a->GetSmallestKey() < b->GetSmallestKey();
+        });
+    });
+    if (!ok) {      // 磁盘上的manifest还引用着输入的SSTable,不能删除它们的文件
+        return false;
+    }
+    for (auto &table : compaction.inputs_[0]) {
+        compact_pointers_[compaction.level_] = table->GetLargestKey();
+    }
+    // 还在被读者使用的SSTable在最后一个引用释放时才删除文件
+    for (auto &inputs : compaction.inputs_) {
+        for (auto &table : inputs) {
+            if (!Contains(outputs, table)) {
+                table->MarkObsolete();
+            }
+        }
+    }
+    return true;
+}
+
+void KvStore::BackgroundCompaction() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (true) {
+        compaction_cv_.wait(lock, [this]() {
+            return closing_ || ((options_.auto_compaction_ || manual_compaction_cnt_ > 0) && NeedsCompaction());
+        });
+        if (closing_) {
+            break;
+        }
+        auto compaction = PickCompaction();
+        compacting_ = true;
+        std::vector<SSTablePtr> outputs;
+        bool ok = true;
+        bool trivial_move = compaction.inputs_[0].size() == 1 && compaction.inputs_[1].empty();
+        size_t subcompaction_cnt = 0;
+        if (trivial_move) {
+            outputs = compaction.inputs_[0];        // 和下一层没有重叠,直接移动到下一层
+        } else {
+            lock.unlock();
+            // 合并的过程中不持有锁,flush和前台的读写不受影响,新flush的SSTable只会加入level 0
+            auto bounds = SplitCompaction(compaction);
+            subcompaction_cnt = bounds.size();
+            ok = DoCompaction(compaction, bounds, &outputs);
+            lock.lock();
+        }
+        // 所有子任务的输出作为一个新的version一起生效
+        if (ok && !InstallCompaction(lock, compaction, outputs)) {
+            ok = false;
+            if (!trivial_move) {
+                for (auto &table : outputs) {
+                    table->MarkObsolete();
+                }
+            }
+        }
+        if (ok) {
+            if (trivial_move) {
+                ++compaction_stats_.trivial_move_cnt_;
+            } else {
+                ++compaction_stats_.compaction_cnt_;
+                compaction_stats_.subcompaction_cnt_ += subcompaction_cnt;
+                compaction_stats_.bytes_read_ += TotalFileSize(compaction.inputs_[0]) + TotalFileSize(compaction.inputs_[1]);
+                compaction_stats_.bytes_written_ += TotalFileSize(outputs);
+            }
+        } else {
+            compaction_error_ = true;
+        }
+        compacting_ = false;
+        done_cv_.notify_all();
+    }
+}
+
+std::vector<uint64_t> KvStore::SplitCompaction(const Compaction &compaction) const {
+    uint64_t input_bytes = 0;
+    std::vector<uint64_t> index_keys;
+    for (auto &inputs : compaction.inputs_) {
+        input_bytes += TotalFileSize(inputs);
+        for (auto &table : inputs) {
+            table->GetIndexKeys(&index_keys);
+        }
+    }
+    size_t split_cnt = std::min<uint64_t>(options_.max_subcompactions_,
+                                          input_bytes / std::max<uint64_t>(options_.target_table_size_, 1));
+    std::vector<uint64_t> bounds;
+    if (split_cnt > 1) {
+        // 每个block的数据量大致相同,按block数量平均分配就是按数据量平均分配
+        std::sort(index_keys.begin(), index_keys.end());
+        for (size_t i = 1; i < split_cnt; ++i) {
+            uint64_t bound = index_keys[i * index_keys.size() / split_cnt];
+            if (bounds.empty() || bound > bounds.back()) {
+                bounds.push_back(bound);
+            }
+        }
+    }
+    if (bounds.empty() || bounds.back() != UINT64_MAX) {
+        bounds.push_back(UINT64_MAX);
+    }
+    return bounds;
+}
+
+bool KvStore::DoCompaction(const Compaction &compaction, const std::vector<uint64_t> &bounds,
+                           std::vector<SSTablePtr> *outputs) {
+    std::vector<std::vector<SSTablePtr>> sub_outputs(bounds.size());
+    std::unique_ptr<bool[]> sub_ok(new bool[bounds.size()]);        // vector<bool>不能被多个线程同时写
+    std::vector<std::thread> workers;
+    for (size_t i = 1; i < bounds.size(); ++i) {
+        workers.emplace_back([&, i]() {
+            sub_ok[i] = DoSubCompaction(compaction, false, bounds[i - 1], bounds[i], &sub_outputs[i]);
+        });
+    }
+    sub_ok[0] = DoSubCompaction(compaction, true, 0, bounds[0], &sub_outputs[0]);
+    for (auto &worker : workers) {
+        worker.join();
+    }
+    bool ok = std::all_of(sub_ok.get(), sub_ok.get() + bounds.size(), [](bool sub) { return sub; });
+    for (auto &sub : sub_outputs) {
+        for (auto &table : sub) {
+            if (!ok) {
+                table->MarkObsolete();
+            }
+        }
+        if (ok) {
+            outputs->insert(outputs->end(), sub.begin(), sub.end());
+        }
+    }
+    return ok;
+}
+
+bool KvStore::DoSubCompaction(const Compaction &compaction, bool first, uint64_t smallest, uint64_t largest,
+                              std::vector<SSTablePtr> *outputs) {
+    std::vector<std::unique_ptr<Iterator>> children;        // 从新到旧
+    if (compaction.level_ == 0) {
+        auto &inputs = compaction.inputs_[0];
+        for (auto it = inputs.rbegin(); it != inputs.rend(); ++it) {
+            children.push_back(NewLevelIterator({*it}, false));
+        }
+    } else {
+        children.push_back(NewLevelIterator(compaction.inputs_[0], false));
+    }
+    children.push_back(NewLevelIterator(compaction.inputs_[1], false));
+    auto iter = NewMergingIterator(std::move(children));
+    auto table_options = NewSSTableOptions();
+    std::unique_ptr<SSTableBuilder> builder;
+    SSTableId table_id;
+    auto finish_table = [&]() {
+        size_t entry_cnt = builder->GetEntryCount();
+        bool finished = builder->Finish();
+        builder.reset();
+        if (!finished) {
+            return false;
+        }
+        auto sstable = std::make_shared<SSTable>(table_id, table_options);
+        outputs->push_back(sstable);
+        return sstable->GetEntryCount() == entry_cnt;
+    };
+    bool ok = true;
+    if (first) {
+        iter->SeekToFirst();
+    } else {
+        iter->Seek(smallest + 1);
+    }
+    for (; ok && iter->Valid() && iter->Key() <= largest; iter->Next()) {
+        Slice value = iter->Value();
+        if (compaction.bottommost_ && IsDeletion(value)) {
+            continue;
+        }
+        if (!builder) {
+            {
+                std::lock_guard<std::mutex> guard(mutex_);
+                table_id = NewSSTableId();
+            }
+            builder.reset(new SSTableBuilder(table_id.path_, table_options));
+        }
+        ok = builder->Add(iter->Key(), value);
+        if (ok && builder->GetFileSize() >= options_.target_table_size_) {
+            ok = finish_table();
+        }
+    }
+    ok = ok && iter->Ok() && (!builder || finish_table());
+    if (!ok) {
+        builder.reset();        // 没有Finish的文件在析构时删除
+        for (auto &table : *outputs) {
+            table->MarkObsolete();
+        }
+        outputs->clear();
+    }
+    return ok;
+}
@@ -0,0 +1,198 @@
+//
+// Created by 杨丰硕 on 2023/3/15.
+//
+
+#ifndef KVSTORE_KVSTORE_H
+#define KVSTORE_KVSTORE_H
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "KvContainer.h"
+#include "MemTable.h"
+#include "SSTable.h"
+#include "WriteBatch.h"
+
+namespace kvstore {
+
+    struct Options {
+        std::string dir_{"."};                      // SSTable文件所在的目录
+        size_t memtable_size_{4 * 1024 * 1024};     // memtable超过这个大小之后被冻结并flush成SSTable
+        size_t max_immutable_cnt_{4};               // 等待flush的memtable过多时阻塞写入
+        bool use_arena_{true};
+        bool memtable_hash_index_{false};           // memtable额外维护hash索引,加速点查
+        size_t block_cache_size_{8 * 1024 * 1024};  // 所有SSTable共享的block cache的容量,为0时不使用
+        size_t index_cache_size_{0};        // SSTable的filter和index占用内存的上限,为0时加载之后一直常驻内存
+        bool use_mmap_{false};                      // SSTable通过mmap读取,此时不经过block cache
+        int bloom_bits_per_key_{10};                // 每个SSTable的Bloom filter中每个key使用的bit数,为0时不使用
+        BlockFormat table_format_{kRawFormat};      // 新生成的SSTable使用的格式
+        SyncPolicy table_sync_policy_{kSyncOnFinish};   // flush生成的SSTable落盘之后才移除对应的memtable
+        bool use_direct_io_for_flush_and_compaction_{false};    // flush和合并用O_DIRECT写SSTable,不挤占page cache
+        CompressionType table_compression_{kLZCompression};
+        VerifyPolicy table_verify_policy_{kVerifyOnFill};   // 读取SSTable的block时的校验策略
+        bool auto_compaction_{true};                // 为false时只在WaitForCompaction中合并
+        size_t level0_compaction_trigger_{4};       // level 0的SSTable数量达到这个值时合并到level 1
+        uint64_t level1_max_bytes_{10 * 1024 * 1024};   // level 1的总大小上限,之后每层是上一层的level_size_multiplier_倍
+        uint64_t level_size_multiplier_{10};
+        uint64_t target_table_size_{2 * 1024 * 1024};   // compaction输出的每个SSTable的大致大小
+        size_t max_subcompactions_{1};              // 一次合并按key范围拆分成多少个子任务并行执行,每个子任务至少有target_table_size_的输入
+        size_t open_threads_{4};                    // 启动时打开manifest中的SSTable的线程数
+        bool preload_indexes_{false};               // 启动时就加载所有SSTable的filter和index,而不是等到第一次访问
+        // 启动时每打开一个SSTable调用一次,参数是已经打开的数量和总数,调用是串行的
+        std::function<void(size_t opened, size_t total)> open_progress_;
+    };
+
+    struct CompactionStats {
+        size_t compaction_cnt_{0};          // 不包括直接移动到下一层的SSTable
+        size_t trivial_move_cnt_{0};
+        size_t subcompaction_cnt_{0};
+        uint64_t bytes_read_{0};            // 输入SSTable的文件大小之和
+        uint64_t bytes_written_{0};
+    };
+
+    // 写入先进入memtable,写满之后在后台线程中flush成level 0的SSTable,同时由新的memtable接收写入.
+    // level 0的SSTable之间key范围可能重叠,另一个后台线程把它们和更低层的SSTable合并成互不重叠的有序序列,
+    // 合并时只保留每个key最新的记录,没有更低层数据的墓碑直接丢弃.
+    // 每次SSTable的集合变化时都会重写dir_中的manifest,启动时只读取manifest,SSTable的索引在第一次访问时才加载.
+    // memtable中的数据在关闭时flush,没有预写日志,进程崩溃时会丢失
+    class KvStore: public KvContainer<uint64_t, std::string> {
+    public:
+        explicit KvStore(const Options &options);
+
+        ~KvStore() override;
+
+        KvStore(const KvStore &kvstore) = delete;
+
+        KvStore& operator=(const KvStore &kvstore) = delete;
+
+        bool Put(const uint64_t &key, const std::string &value) override;
+
+        bool Get(const uint64_t &key, std::string *value) const override;
+
+        bool Delete(const uint64_t &key) override;
+
+        // 整个batch写入同一个memtable,batch中的记录会被重新排序
+        bool Write(WriteBatch &batch);
+
+        ContainType GetType() override {
+            return LSM_CTYPE;
+        }
+
+        void Dump() override;
+
+        // 冻结当前的memtable,并等待所有memtable都flush到SSTable中,flush失败时返回false
+        bool Flush();
+
+        // 等待所有memtable flush完成,并且每一层都不再需要合并,auto_compaction_为false时也会合并
+        void WaitForCompaction();
+
+        // 按key递增遍历所有没有被删除的key,value已经解码.迭代器持有创建时的快照,之后的写入不可见
+        std::unique_ptr<Iterator> NewIterator() const;
+
+        size_t GetSSTableCount() const;
+
+        size_t GetLevelTableCount(int level) const;
+
+        CompactionStats GetCompactionStats() const;
+
+        // index_cache_size_为0时返回0
+        size_t GetIndexCacheUsage() const;
+
+        static constexpr int kNumLevels = 7;
+
+    private:
+        using MemTablePtr = std::shared_ptr<MemTable>;
+
+        using SSTablePtr = std::shared_ptr<SSTable>;
+
+        // 某一时刻所有SSTable的集合,创建之后不再修改,读者持有引用期间其中的SSTable不会被删除
+        struct Version {
+            std::vector<SSTablePtr> levels_[kNumLevels];        // level 0从旧到新,其他层按key范围排序且互不重叠
+        };
+
+        using VersionPtr = std::shared_ptr<const Version>;
+
+        // 把level_层的inputs_[0]和下一层中与它们key范围重叠的inputs_[1]合并成下一层的SSTable
+        struct Compaction {
+            int level_{0};
+            std::vector<SSTablePtr> inputs_[2];
+            bool bottommost_{false};        // 更低的层中没有重叠的数据,可以丢弃墓碑
+        };
+
+        // 读取manifest并延迟打开其中的SSTable,删除不在manifest中的SSTable文件,只在构造函数中调用
+        void Recover();
+
+        // 以下函数都需要持有mutex_
+
+        // flush失败之后等待flush的memtable达到上限时返回false,写入被拒绝
+        bool MakeRoomForWrite(std::unique_lock<std::mutex> &lock);
+
+        void FreezeMemTable();
+
+        SSTableId NewSSTableId();
+
+        void BackgroundFlush();
+
+        SSTableOptions NewSSTableOptions() const;
+
+        // 在current_的副本上执行edit,写入manifest成功之后才替换current_,失败时磁盘上仍然是上一次成功写入的版本.
+        // 写manifest期间释放lock,由manifest_mutex_保证同一时间只有一个线程修改version,返回时重新持有lock
+        bool LogAndApply(std::unique_lock<std::mutex> &lock, const std::function<void(Version *)> &edit);
+
+        uint64_t MaxBytesForLevel(int level) const;
+
+        bool NeedsCompaction() const;
+
+        // 选出下一个需要合并的层和输入的SSTable
+        Compaction PickCompaction();
+
+        // manifest写入失败时返回false,version不变,输入的SSTable不会被删除
+        bool InstallCompaction(std::unique_lock<std::mutex> &lock, const Compaction &compaction,
+                               const std::vector<SSTablePtr> &outputs);
+
+        void BackgroundCompaction();
+
+        // 以下函数都不持有mutex_
+
+        // 根据输入SSTable的block index把key空间分成若干段,每段的输入数据量大致相同,返回每段最大的key
+        std::vector<uint64_t> SplitCompaction(const Compaction &compaction) const;
+
+        // bounds中的每段在单独的线程中合并,输出按key范围排好序,任何一段失败时删除所有生成的文件并返回false
+        bool DoCompaction(const Compaction &compaction, const std::vector<uint64_t> &bounds,
+                          std::vector<SSTablePtr> *outputs);
+
+        // 只合并(smallest, largest]中的key,第一段的smallest没有限制
+        bool DoSubCompaction(const Compaction &compaction, bool first, uint64_t smallest, uint64_t largest,
+                             std::vector<SSTablePtr> *outputs);
+
+        Options options_;
+        std::unique_ptr<BlockCache> block_cache_;
+        std::unique_ptr<IndexCache> index_cache_;
+        mutable std::mutex mutex_;
+        std::mutex manifest_mutex_;     // 在mutex_之前获取,持有期间只有一个线程修改version和写manifest
+        std::condition_variable flush_cv_;      // 通知后台线程有新的immutable memtable
+        std::condition_variable done_cv_;       // 通知写者有memtable被flush完成
+        MemTablePtr mem_;
+        std::deque<MemTablePtr> imms_;          // 等待flush的memtable,从旧到新
+        bool flush_error_{false};       // flush失败之后不再自动flush,没有flush的memtable仍然可读
+        VersionPtr current_;
+        uint64_t compact_pointers_[kNumLevels]{};       // 每层上一次合并的最大的key,下一次从它之后开始
+        std::condition_variable compaction_cv_;     // 通知合并线程可能需要合并
+        bool compacting_{false};
+        bool compaction_error_{false};      // 合并失败之后不再自动合并,数据仍然可读
+        size_t manual_compaction_cnt_{0};   // 正在WaitForCompaction的线程数
+        CompactionStats compaction_stats_;
+        uint64_t next_table_id_{0};
+        bool closing_{false};
+        std::thread flush_thread_;
+        std::thread compaction_thread_;
+    };
+
+}
+
+#endif //KVSTORE_KVSTORE_H
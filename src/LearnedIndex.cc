@@ -0,0 +1,96 @@
+//
+// Created by 杨丰硕 on 2023/3/27.
+//
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include "LearnedIndex.h"
+#include "Coding.h"
+
+using namespace kvstore;
+
+void LearnedIndex::Build(const std::vector<uint64_t> &keys, size_t max_error) {
+    max_error_ = max_error;
+    key_cnt_ = keys.size();
+    segments_.clear();
+    size_t start = 0;
+    while (start < keys.size()) {
+        // 从起点出发的所有可行斜率构成一个锥形,每加入一个点都会把它收窄
+        double low_slope = 0, high_slope = std::numeric_limits<double>::infinity();
+        size_t end = start + 1;
+        for (; end < keys.size(); ++end) {
+            double dx = static_cast<double>(keys[end] - keys[start]);
+            double dy = static_cast<double>(end - start);
+            double new_low = std::max(low_slope, (dy - max_error) / dx);
+            double new_high = std::min(high_slope, (dy + max_error) / dx);
+            if (new_low > new_high) {
+                break;
+            }
+            low_slope = new_low;
+            high_slope = new_high;
+        }
+        double slope = std::isinf(high_slope) ? 0 : (low_slope + high_slope) / 2;
+        segments_.push_back(Segment{keys[start], start, slope});
+        start = end;
+    }
+    segments_.shrink_to_fit();
+}
+
+void LearnedIndex::EncodeTo(std::string *dst) const {
+    PutFixed64(dst, max_error_);
+    PutFixed64(dst, segments_.size());
+    for (auto &segment : segments_) {
+        uint64_t slope_bits;
+        std::memcpy(&slope_bits, &segment.slope_, sizeof(slope_bits));
+        PutFixed64(dst, segment.first_key_);
+        PutFixed64(dst, segment.first_pos_);
+        PutFixed64(dst, slope_bits);
+    }
+}
+
+bool LearnedIndex::DecodeFrom(const Slice &data, size_t key_cnt) {
+    segments_.clear();
+    if (data.size_ < sizeof(uint64_t) * 2) {
+        return false;
+    }
+    max_error_ = DecodeFixed64(data.data_);
+    uint64_t segment_cnt = DecodeFixed64(data.data_ + sizeof(uint64_t));
+    const size_t segment_size = sizeof(uint64_t) * 3;
+    if (segment_cnt > key_cnt || data.size_ != sizeof(uint64_t) * 2 + segment_cnt * segment_size) {
+        return false;
+    }
+    key_cnt_ = key_cnt;
+    segments_.resize(segment_cnt);
+    const char *p = data.data_ + sizeof(uint64_t) * 2;
+    for (auto &segment : segments_) {
+        uint64_t slope_bits = DecodeFixed64(p + sizeof(uint64_t) * 2);
+        segment.first_key_ = DecodeFixed64(p);
+        segment.first_pos_ = std::min<uint64_t>(DecodeFixed64(p + sizeof(uint64_t)), key_cnt);
+        std::memcpy(&segment.slope_, &slope_bits, sizeof(slope_bits));
+        if (!std::isfinite(segment.slope_) || segment.slope_ < 0) {
+            segment.slope_ = 0;
+        }
+        p += segment_size;
+    }
+    return true;
+}
+
+void LearnedIndex::Predict(uint64_t key, size_t *begin, size_t *end) const {
+    auto it = std::upper_bound(segments_.begin(), segments_.end(), key,
+                               [](uint64_t k, const Segment &segment) { return k < segment.first_key_; });
+    if (it == segments_.begin()) {      // 比所有key都小
+        *begin = *end = 0;
+        return;
+    }
+    auto &segment = *(it - 1);
+    // 超出这一段最后一个key的部分不能外推,lower bound最多是下一段的起点
+    double limit = it == segments_.end() ? key_cnt_ : it->first_pos_;
+    double predict = segment.first_pos_ + segment.slope_ * static_cast<double>(key - segment.first_key_);
+    predict = std::min(predict, limit);
+    // 比误差多留一个位置,抵消浮点数的舍入
+    double low = predict - max_error_ - 1, high = predict + max_error_ + 2;
+    *begin = low <= 0 ? 0 : std::min(static_cast<size_t>(low), key_cnt_);
+    *end = high >= key_cnt_ ? key_cnt_ : static_cast<size_t>(high);
+    *begin = std::min(*begin, *end);
+}
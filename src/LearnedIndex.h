@@ -0,0 +1,65 @@
+//
+// Created by 杨丰硕 on 2023/3/27.
+//
+
+#ifndef KVSTORE_LEARNEDINDEX_H
+#define KVSTORE_LEARNEDINDEX_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "Slice.h"
+
+namespace kvstore {
+
+    // 用分段线性函数拟合有序key到下标的映射,每一段对其中所有key的预测误差都不超过max_error_.
+    // 接近线性分布的key只需要很少的段,查找时先预测位置,再在一个很小的窗口中查找.
+    // 编码之后的格式是[max_error] [段数] [第一个key,第一个下标,斜率]*段数,都是8字节
+    class LearnedIndex {
+    public:
+        LearnedIndex() = default;
+
+        // 贪心地扩展每一段,直到新的key无法和之前的key共用一条误差范围内的直线
+        void Build(const std::vector<uint64_t> &keys, size_t max_error);
+
+        void EncodeTo(std::string *dst) const;
+
+        // key_cnt是拟合时的key数量,数据不完整时返回false
+        bool DecodeFrom(const Slice &data, size_t key_cnt);
+
+        bool Empty() const {
+            return segments_.empty();
+        }
+
+        // 给出一个包含key的lower bound的下标窗口[*begin, *end),*end不超过key的数量.
+        // 模型对不存在的key也成立,但是调用者仍然需要检查窗口的边界以防模型损坏
+        void Predict(uint64_t key, size_t *begin, size_t *end) const;
+
+        size_t GetSegmentCount() const {
+            return segments_.size();
+        }
+
+        size_t GetMaxError() const {
+            return max_error_;
+        }
+
+        size_t MemoryUsage() const {
+            return segments_.capacity() * sizeof(Segment);
+        }
+
+    private:
+        struct Segment {
+            uint64_t first_key_;
+            uint64_t first_pos_;
+            double slope_;
+        };
+
+        size_t max_error_{0};
+        size_t key_cnt_{0};
+        std::vector<Segment> segments_;
+    };
+
+}
+
+#endif //KVSTORE_LEARNEDINDEX_H
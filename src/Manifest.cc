@@ -0,0 +1,101 @@
+//
+// Created by 杨丰硕 on 2023/4/2.
+//
+#include <cstdio>
+#include <unistd.h>
+#include "Manifest.h"
+#include "Coding.h"
+#include "Crc32c.h"
+#include "DiskStorage.h"
+
+using namespace kvstore;
+
+constexpr uint64_t Manifest::kManifestMagic;
+constexpr size_t Manifest::kEntrySize;
+
+void Manifest::EncodeTo(std::string *dst) const {
+    std::string manifest;
+    manifest.reserve(sizeof(uint64_t) * 3 + entries_.size() * kEntrySize + sizeof(uint32_t));
+    PutFixed64(&manifest, kManifestMagic);
+    PutFixed64(&manifest, next_table_id_);
+    PutFixed64(&manifest, entries_.size());
+    for (auto &entry : entries_) {
+        auto &properties = entry.properties_;
+        PutFixed64(&manifest, static_cast<uint64_t>(entry.level_));
+        PutFixed64(&manifest, entry.table_id_);
+        PutFixed64(&manifest, properties.file_size_);
+        PutFixed64(&manifest, properties.largest_key_);
+        PutFixed64(&manifest, properties.block_cnt_);
+        properties.footer_.EncodeTo(&manifest);
+    }
+    PutFixed32(&manifest, Crc32c(manifest.data(), manifest.size()));
+    dst->append(manifest);
+}
+
+bool Manifest::DecodeFrom(const Slice &data) {
+    const size_t header_size = sizeof(uint64_t) * 3;
+    if (data.size_ < header_size + sizeof(uint32_t)) {
+        return false;
+    }
+    size_t checked_size = data.size_ - sizeof(uint32_t);
+    if (DecodeFixed64(data.data_) != kManifestMagic
+        || Crc32c(data.data_, checked_size) != DecodeFixed32(data.data_ + checked_size)) {
+        return false;
+    }
+    uint64_t entry_cnt = DecodeFixed64(data.data_ + sizeof(uint64_t) * 2);
+    if (entry_cnt != (checked_size - header_size) / kEntrySize || (checked_size - header_size) % kEntrySize != 0) {
+        return false;
+    }
+    std::vector<ManifestEntry> entries(entry_cnt);
+    const char *p = data.data_ + header_size;
+    for (auto &entry : entries) {
+        auto &properties = entry.properties_;
+        uint64_t level = DecodeFixed64(p);
+        entry.table_id_ = DecodeFixed64(p + sizeof(uint64_t));
+        properties.file_size_ = DecodeFixed64(p + sizeof(uint64_t) * 2);
+        properties.largest_key_ = DecodeFixed64(p + sizeof(uint64_t) * 3);
+        properties.block_cnt_ = DecodeFixed64(p + sizeof(uint64_t) * 4);
+        // footer中的位置是相对于SSTable文件的,用manifest中的文件大小检查
+        if (level > INT32_MAX || properties.file_size_ < Footer::kEncodedSize
+            || !properties.footer_.DecodeFrom(p + sizeof(uint64_t) * 5, properties.file_size_ - Footer::kEncodedSize)) {
+            return false;
+        }
+        entry.level_ = static_cast<int>(level);
+        p += kEntrySize;
+    }
+    next_table_id_ = DecodeFixed64(data.data_ + sizeof(uint64_t));
+    entries_.swap(entries);
+    return true;
+}
+
+std::string kvstore::ManifestPath(const std::string &dir) {
+    return dir + "/MANIFEST";
+}
+
+bool kvstore::WriteManifest(const std::string &dir, const Manifest &manifest, bool sync) {
+    std::string data;
+    manifest.EncodeTo(&data);
+    std::string path = ManifestPath(dir), tmp_path = path + ".tmp";
+    FileOptions options;
+    options.buffer_size_ = data.size();
+    DiskStorage file;
+    if (!file.OpenForWrite(tmp_path, true, options)) {
+        return false;
+    }
+    bool ok = file.Append(data) && (sync ? file.Sync() : file.Flush());
+    ok = file.Close() && ok;
+    if (!ok || ::rename(tmp_path.c_str(), path.c_str()) != 0) {
+        ::unlink(tmp_path.c_str());
+        return false;
+    }
+    return true;
+}
+
+bool kvstore::ReadManifest(const std::string &dir, Manifest *manifest) {
+    DiskStorage file;
+    if (!file.OpenForRead(ManifestPath(dir))) {
+        return false;
+    }
+    std::string data(file.Size(), '\0');
+    return (data.empty() || file.ReadAt(0, data.size(), &data[0])) && manifest->DecodeFrom(Slice(data));
+}
@@ -0,0 +1,48 @@
+//
+// Created by 杨丰硕 on 2023/4/2.
+//
+
+#ifndef KVSTORE_MANIFEST_H
+#define KVSTORE_MANIFEST_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "SSTable.h"
+
+namespace kvstore {
+
+    struct ManifestEntry {
+        int level_{0};
+        uint64_t table_id_{0};
+        TableProperties properties_;
+    };
+
+    // 某一时刻所有SSTable的快照,启动时只读取manifest,SSTable按照其中的信息延迟打开.
+    // 格式: [magic][next_table_id][entry数量] ([level][table_id][文件大小][最大的key][block数量][footer])* [CRC32C],
+    // 每次version变化时整个重写到临时文件再rename,磁盘上总是完整的旧版本或者新版本
+    struct Manifest {
+        static constexpr uint64_t kManifestMagic = 0x6b766d616e696673ULL;
+
+        static constexpr size_t kEntrySize = sizeof(uint64_t) * 5 + Footer::kEncodedSize;
+
+        uint64_t next_table_id_{0};
+        std::vector<ManifestEntry> entries_;       // 同一层中的顺序和version中的相同
+
+        void EncodeTo(std::string *dst) const;
+
+        // 数据不完整或者校验和不匹配时返回false
+        bool DecodeFrom(const Slice &data);
+    };
+
+    std::string ManifestPath(const std::string &dir);
+
+    // sync为true时在rename之前fsync临时文件
+    bool WriteManifest(const std::string &dir, const Manifest &manifest, bool sync);
+
+    // manifest不存在或者损坏时返回false
+    bool ReadManifest(const std::string &dir, Manifest *manifest);
+
+}
+
+#endif //KVSTORE_MANIFEST_H
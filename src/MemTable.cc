@@ -0,0 +1,86 @@
+//
+// Created by 杨丰硕 on 2023/3/15.
+//
+#include "MemTable.h"
+#include "WriteBatch.h"
+
+using namespace kvstore;
+
+namespace {
+
+    class MemTableIterator: public Iterator {
+    public:
+        explicit MemTableIterator(const MemTable::Table &table): iter_(table) {}
+
+        bool Valid() const override {
+            return node_ != nullptr;
+        }
+
+        void SeekToFirst() override {
+            node_ = iter_.SeekToFirst();
+        }
+
+        void Seek(uint64_t key) override {
+            node_ = iter_.Seek(key);
+        }
+
+        void Next() override {
+            node_ = iter_.Next();
+        }
+
+        uint64_t Key() const override {
+            return node_->key_;
+        }
+
+        Slice Value() const override {
+            return Slice(node_->value_);
+        }
+
+    private:
+        SkipListIterator<uint64_t, std::string> iter_;
+        const Node<uint64_t, std::string> *node_{nullptr};
+    };
+
+}
+
+MemTable::MemTable(bool use_arena, bool use_hash_index):
+        table_(Table::Comparator(), use_arena, use_hash_index) {}
+
+bool MemTable::Put(uint64_t key, const std::string &value) {
+    Add(key, EncodeValue(kTypeValue, value));
+    return true;
+}
+
+bool MemTable::Delete(uint64_t key) {
+    Add(key, EncodeValue(kTypeDeletion, ""));
+    return true;
+}
+
+bool MemTable::Write(WriteBatch &batch) {
+    assert(!IsFrozen());
+    table_.PutBatch(batch.entries_);
+    for (auto &entry : batch.entries_) {
+        memory_usage_ += EntryOverhead() + sizeof(entry.first) + entry.second.size();
+    }
+    return true;
+}
+
+bool MemTable::Get(uint64_t key, std::string *value, bool *deleted) const {
+    std::string encoded;
+    if (!table_.Get(key, &encoded)) {
+        return false;
+    }
+    *deleted = !DecodeValue(encoded, value);
+    return true;
+}
+
+void MemTable::Add(uint64_t key, const std::string &encoded) {
+    assert(!IsFrozen());
+    table_.Put(key, encoded);
+    // 覆盖写时旧的value也会被重复统计,对于判断何时冻结来说已经足够
+    memory_usage_ += EntryOverhead() + sizeof(key) + encoded.size();
+}
+
+std::unique_ptr<Iterator> MemTable::NewIterator() const {
+    return std::unique_ptr<Iterator>(new MemTableIterator(table_));
+}
@@ -0,0 +1,105 @@
+//
+// Created by 杨丰硕 on 2023/3/15.
+//
+
+#ifndef KVSTORE_MEMTABLE_H
+#define KVSTORE_MEMTABLE_H
+
+#include <atomic>
+#include <memory>
+#include <string>
+#include "Iterator.h"
+#include "SkipList.h"
+
+namespace kvstore {
+
+    // 跳表中保存的value的第一个字节是类型,删除操作写入的是只有类型的墓碑
+    enum ValueType: char {
+        kTypeDeletion = 0,
+        kTypeValue = 1,
+    };
+
+    inline std::string EncodeValue(ValueType type, const std::string &value) {
+        std::string encoded;
+        encoded.reserve(value.size() + 1);
+        encoded.push_back(type);
+        encoded.append(value);
+        return encoded;
+    }
+
+    // 返回false表示这是一个墓碑
+    inline bool DecodeValue(const std::string &encoded, std::string *value) {
+        if (encoded.empty() || encoded[0] == kTypeDeletion) {
+            return false;
+        }
+        if (value) {
+            value->assign(encoded, 1, std::string::npos);
+        }
+        return true;
+    }
+
+    class WriteBatch;
+
+    class MemTable {
+    public:
+        using Table = SkipList<uint64_t, std::string>;
+
+        explicit MemTable(bool use_arena = true, bool use_hash_index = false);
+
+        ~MemTable() = default;
+
+        MemTable(const MemTable &memtable) = delete;
+
+        MemTable& operator=(const MemTable &memtable) = delete;
+
+        bool Put(uint64_t key, const std::string &value);
+
+        bool Delete(uint64_t key);
+
+        // batch中的记录会被按key重新排序
+        bool Write(WriteBatch &batch);
+
+        // 返回true表示memtable中有这个key的记录,*deleted说明这条记录是不是墓碑
+        bool Get(uint64_t key, std::string *value, bool *deleted) const;
+
+        // 冻结之后不再接受写入,可以被多个线程无锁地读取
+        void Freeze() {
+            frozen_.store(true, std::memory_order_release);
+        }
+
+        bool IsFrozen() const {
+            return frozen_.load(std::memory_order_acquire);
+        }
+
+        size_t ApproximateMemoryUsage() const {
+            return memory_usage_;
+        }
+
+        // 返回的value是带类型的编码,只能在冻结之后使用,或者由调用者保证遍历期间没有写入
+        std::unique_ptr<Iterator> NewIterator() const;
+
+        const Table &GetTable() const {
+            return table_;
+        }
+
+    private:
+        // 每个结点除了key和value之外的大致开销(结点头部加上平均高度的next指针)
+        static constexpr size_t kNodeOverhead = sizeof(Node<uint64_t, std::string>) + 2 * sizeof(void*);
+
+        // hash索引中每个key的大致开销(桶指针加上链表结点)
+        static constexpr size_t kIndexOverhead = 4 * sizeof(void*);
+
+        size_t EntryOverhead() const {
+            return kNodeOverhead + (table_.UseHashIndex() ? kIndexOverhead : 0);
+        }
+
+        void Add(uint64_t key, const std::string &encoded);
+
+        Table table_;
+        size_t memory_usage_{0};
+        std::atomic<bool> frozen_{false};
+    };
+
+}
+
+#endif //KVSTORE_MEMTABLE_H
@@ -1,101 +1,657 @@
 //
 // Created by 杨丰硕 on 2023/3/9.
 //
+#include <algorithm>
+#include <cassert>
+#include <sys/mman.h>
+#include <unistd.h>
 #include "SSTable.h"
-#include "DiskStorage.h"
+#include "SSTableBuilder.h"
+#include "Coding.h"
+#include "Crc32c.h"
 
 using namespace kvstore;
-// 将文件中的SSTable进行反序列化
-SSTable::SSTable(const SSTableId &tableId):
-        table_id_(tableId){
-    std::ifstream ifs(table_id_.path_, std::ios::binary);
-    ReadUint64(ifs, entry_cnt_);
-    keys_.resize(entry_cnt_);
-    offsets_.resize(entry_cnt_);
 
-    for (size_t i = 0; i < entry_cnt_; ++i) {
-        ReadUint64(ifs, keys_[i]);
-        ReadUint64(ifs, offsets_[i]);
-    }
+// block是文件中包括头部和尾部的完整内容
+static bool BlockChecksumMatch(const char *block, size_t size) {
+    size_t checked_size = size - kBlockTrailerSize;
+    return Crc32c(block, checked_size) == DecodeFixed32(block + checked_size);
+}
 
-    ReadUint64(ifs, block_cnt_);
-    block_offsets_.resize(block_cnt_);
-    for (size_t i = 0; i < block_cnt_; ++i) {
-        ReadUint64(ifs, block_offsets_[i]);
-    }
-    ifs.close();
+// 将文件中的SSTable进行反序列化
+SSTable::SSTable(const SSTableId &tableId, const SSTableOptions &options):
+        table_id_(tableId), options_(options) {
+    OpenForRead();
 }
-// 从跳表中解析出SSTable的内容
-SSTable::SSTable(const KvContainer &sklist, const SSTableId &tableId):
-        table_id_(tableId){
+// 从跳表中解析出SSTable的内容,边遍历边写文件
+SSTable::SSTable(const KvContainer &sklist, const SSTableId &tableId, const SSTableOptions &options):
+        table_id_(tableId), options_(options) {
     KvIterator kvIterator(sklist);
-    int entry_cnt_inblock = 0;
-    uint64_t offset = 0;
-    uint64_t block_offset = 0;
-    std::string block_content;
-    block_content.reserve(DiskStorage::BLOCK_SIZE);
-    std::string sstable_content;
-
-    while (kvIterator.HasNext()) {
+    kvIterator.Init();
+    SSTableBuilder builder(table_id_.path_, options_);
+    while (ok_ && kvIterator.HasNext()) {
         auto curr_node = kvIterator.Next();
-        keys_.push_back(curr_node->key_);
-        offsets_.push_back(offset);
-        offset += curr_node->value_.size();
-        block_content += curr_node->value_;
-        ++entry_cnt_;
-        ++entry_cnt_inblock;
-        if (block_content.size() >= DiskStorage::BLOCK_SIZE) {
-            block_offsets_.push_back(block_offset);
-            sstable_content += block_content;
-            block_offset += block_content.size();
-            block_content.clear();
-            entry_cnt_inblock = 0;
-            ++block_cnt_;
-        }
+        ok_ = builder.Add(curr_node->key_, curr_node->value_);
+    }
+    ok_ = ok_ && builder.Finish();
+    if (!ok_) {     // 写了一半的文件已经被builder删除
+        InstallIndex(std::make_shared<TableIndex>());
+        return;
     }
+    OpenForRead();
+    ok_ = entry_cnt_ == builder.GetEntryCount();
+}
 
-    if (entry_cnt_inblock > 0) {
-        block_offsets_.push_back(block_offset);
-        sstable_content += block_content;
-        block_offset += block_content.size();
-        block_content.clear();
-        ++block_cnt_;
+SSTable::SSTable(const SSTableId &tableId, const TableProperties &properties, const SSTableOptions &options):
+        table_id_(tableId), options_(options), footer_(properties.footer_), entry_cnt_(properties.footer_.entry_cnt_),
+        block_cnt_(properties.block_cnt_), largest_key_(properties.largest_key_) {
+    // 文件不存在或者大小和manifest中记录的不一致时当作空表
+    if (!OpenFile() || file_size_ != properties.file_size_) {
+        entry_cnt_ = block_cnt_ = 0;
+        InstallIndex(std::make_shared<TableIndex>());
+    }
+    if (mapped_) {
+        verified_blocks_.reset(new std::atomic<uint64_t>[(block_cnt_ + 63) / 64]());
     }
+}
 
-    block_offsets_.push_back(block_offset);
-    Save(sstable_content);
+SSTable::~SSTable() {
+    if (options_.index_cache_) {        // 索引可能指向映射区域,先于解除映射释放
+        options_.index_cache_->Erase(table_id_.table_id_);
+    }
+    if (mapped_) {
+        ::munmap(const_cast<char *>(mapped_), mapped_size_);
+    }
+    if (obsolete_.load(std::memory_order_relaxed)) {
+        ::unlink(table_id_.path_.c_str());
+    }
 }
 
 bool SSTable::Get(uint64_t key, std::string *value, bool load) const {
-    auto findit = std::lower_bound(keys_.begin(), keys_.end(), key);
-    if (*findit != key) {
+    if (entry_cnt_ == 0 || key < footer_.smallest_key_ || key > largest_key_) {      // 不需要加载索引
+        return false;
+    }
+    IndexCache::Index index_holder;
+    auto &index = AcquireIndex(&index_holder);
+    if (!BloomFilter::KeyMayMatch(key, index.filter_)) {        // 大部分不存在的key在这里就被过滤掉,不需要读取block
+        return false;
+    }
+    size_t blockno = index.FindBlock(key);
+    Slice contents, found;
+    BlockCache::Block holder;
+    if (blockno == index.block_cnt_ || !GetBlockContents(index, blockno, &contents, &holder)
+        || !BlockReader(contents, footer_.format_).Get(key, &found)) {
         return false;
     }
     if (load) {     // 表示的是是否需要将value加载出来
-
+        value->assign(found.data_, found.size_);
     }
     return true;
 }
 
+bool SSTable::Get(uint64_t key, Slice *value, BlockCache::Block *holder) const {
+    if ((!mapped_ && !holder) || entry_cnt_ == 0 || key < footer_.smallest_key_ || key > largest_key_) {
+        return false;
+    }
+    IndexCache::Index index_holder;
+    auto &index = AcquireIndex(&index_holder);
+    if (!BloomFilter::KeyMayMatch(key, index.filter_)) {
+        return false;
+    }
+    size_t blockno = index.FindBlock(key);
+    Slice contents;
+    if (blockno == index.block_cnt_ || !GetBlockContents(index, blockno, &contents, holder)) {
+        return false;
+    }
+    return BlockReader(contents, footer_.format_).Get(key, value);
+}
+
 bool SSTable::Insert(uint64_t key, const std::string &value) {
     return false;
 }
 
+bool SSTable::KeyMayMatch(uint64_t key) const {
+    IndexCache::Index index_holder;
+    return BloomFilter::KeyMayMatch(key, AcquireIndex(&index_holder).filter_);
+}
+
 bool SSTable::LoadBlock(size_t blockno, std::string *value) const {
-    return false;
+    IndexCache::Index index_holder;
+    Slice contents;
+    BlockCache::Block holder;
+    if (!GetBlockContents(AcquireIndex(&index_holder), blockno, &contents, &holder)) {
+        return false;
+    }
+    value->assign(contents.data_, contents.size_);
+    return true;
+}
+
+void SSTable::GetIndexKeys(std::vector<uint64_t> *keys) const {
+    IndexCache::Index index_holder;
+    auto &index = AcquireIndex(&index_holder);
+    for (size_t blockno = 0; blockno < index.block_cnt_; ++blockno) {
+        keys->push_back(index.KeyAt(blockno));
+    }
+}
+
+TableProperties SSTable::GetProperties() const {
+    TableProperties properties;
+    properties.file_size_ = file_size_;
+    properties.largest_key_ = largest_key_;
+    properties.block_cnt_ = block_cnt_;
+    properties.footer_ = footer_;
+    return properties;
+}
+
+size_t SSTable::GetFilterSize() const {
+    IndexCache::Index index_holder;
+    return AcquireIndex(&index_holder).filter_.size_;
+}
+
+size_t SSTable::GetIndexMemoryUsage() const {
+    IndexCache::Index index_holder;
+    return AcquireIndex(&index_holder).MemoryUsage();
+}
+
+size_t SSTable::GetLearnedSegmentCount() const {
+    IndexCache::Index index_holder;
+    return AcquireIndex(&index_holder).learned_index_.GetSegmentCount();
+}
+
+bool SSTable::IsIndexLoaded() const {
+    if (resident_.load(std::memory_order_acquire)) {
+        return true;
+    }
+    return options_.index_cache_ && options_.index_cache_->Lookup(table_id_.table_id_);
+}
+
+void SSTable::PreloadIndex() const {
+    IndexCache::Index index_holder;
+    AcquireIndex(&index_holder);
+}
+
+void SSTable::AdviseAccess(bool sequential) {
+    options_.sequential_access_ = sequential;
+    if (mapped_) {
+        ::madvise(const_cast<char *>(mapped_), mapped_size_, sequential ? MADV_SEQUENTIAL : MADV_RANDOM);
+    }
+    file_.Advise(sequential ? kSequentialAccess : kRandomAccess);
+}
+
+void SSTable::OpenForRead() {
+    if (!OpenFile() || !ReadFooter(file_size_)) {       // 文件不完整或者损坏时当作空表
+        entry_cnt_ = block_cnt_ = 0;
+        InstallIndex(std::make_shared<TableIndex>());
+        return;
+    }
+    auto index = LoadTableIndex();
+    block_cnt_ = index->block_cnt_;
+    if (block_cnt_ == 0) {
+        entry_cnt_ = 0;
+    } else {
+        largest_key_ = index->KeyAt(block_cnt_ - 1);
+    }
+    if (mapped_) {
+        verified_blocks_.reset(new std::atomic<uint64_t>[(block_cnt_ + 63) / 64]());
+    }
+    InstallIndex(std::move(index));
+}
+
+bool SSTable::OpenFile() {
+    FileOptions file_options;
+    file_options.access_pattern_ = options_.sequential_access_ ? kSequentialAccess : kRandomAccess;
+    if (!file_.OpenForRead(table_id_.path_, file_options)) {
+        return false;
+    }
+    file_size_ = file_.Size();
+    if (options_.use_mmap_) {
+        MapFile(file_size_);
+    }
+    return true;
+}
+
+void SSTable::MapFile(size_t file_size) {
+    if (file_size == 0) {
+        return;
+    }
+    void *addr = ::mmap(nullptr, file_size, PROT_READ, MAP_SHARED, file_.GetFd(), 0);
+    if (addr == MAP_FAILED) {       // 退回到pread
+        options_.use_mmap_ = false;
+        return;
+    }
+    mapped_ = static_cast<const char *>(addr);
+    mapped_size_ = file_size;
+    file_.Close();      // 映射建立之后不再需要文件描述符
+    AdviseAccess(options_.sequential_access_);
+}
+
+bool SSTable::ReadFooter(uint64_t file_size) {
+    if (file_size < Footer::kEncodedSize) {
+        return false;
+    }
+    std::string footer;
+    uint64_t footer_offset = file_size - Footer::kEncodedSize;
+    if (!ReadFile(footer_offset, Footer::kEncodedSize, &footer) || !footer_.DecodeFrom(footer.data(), footer_offset)) {
+        return false;
+    }
+    entry_cnt_ = footer_.entry_cnt_;
+    return true;
+}
+
+bool SSTable::ReadMeta(std::string *scratch, Slice *meta) const {
+    uint64_t size = footer_.index_offset_ + footer_.index_size_ - footer_.filter_offset_;
+    if (mapped_) {
+        if (footer_.filter_offset_ + size > mapped_size_) {
+            return false;
+        }
+        *meta = Slice(mapped_ + footer_.filter_offset_, size);
+    } else {
+        if (!ReadFile(footer_.filter_offset_, size, scratch)) {
+            return false;
+        }
+        *meta = Slice(*scratch);
+    }
+    return options_.verify_policy_ == kNoVerify || Crc32c(meta->data_, meta->size_) == footer_.meta_crc_;
+}
+
+Slice SSTable::MetaSection(const Slice &meta, uint64_t offset, uint64_t size) const {
+    return Slice(meta.data_ + (offset - footer_.filter_offset_), size);
+}
+
+std::shared_ptr<TableIndex> SSTable::LoadTableIndex() const {
+    auto index = std::make_shared<TableIndex>();
+    std::string meta_data;
+    Slice meta;
+    if (entry_cnt_ == 0 || !ReadMeta(&meta_data, &meta)) {
+        return index;
+    }
+    LoadFilter(meta, index.get());
+    if (!LoadIndex(meta, index.get())) {
+        return std::make_shared<TableIndex>();
+    }
+    LoadLearnedIndex(meta, index.get());
+    if (index->learned_index_.Empty() && !index->index_keys_.empty() && options_.index_layout_ != kSortedLayout) {
+        index->index_searcher_.Build(index->index_keys_, options_.index_layout_);
+    }
+    return index;
+}
+
+void SSTable::LoadFilter(const Slice &meta, TableIndex *index) const {
+    index->filter_ = MetaSection(meta, footer_.filter_offset_, footer_.filter_size_);
+    if (!mapped_) {
+        index->filter_data_.assign(index->filter_.data_, index->filter_.size_);
+        index->filter_ = Slice(index->filter_data_);
+    }
+}
+
+bool SSTable::LoadIndex(const Slice &meta, TableIndex *index) const {
+    Slice data = MetaSection(meta, footer_.index_offset_, footer_.index_size_);
+    if (mapped_ && footer_.format_ == kRawFormat) {     // index原地读取
+        index->mapped_index_ = data.data_;
+        index->block_cnt_ = footer_.index_size_ / kRawIndexEntrySize;
+        return true;
+    }
+    // kCompactFormat的block数量在解码index之后才知道
+    if (!DecodeIndex(footer_.format_, data, &index->index_keys_, &index->block_handles_)) {
+        return false;
+    }
+    index->block_cnt_ = index->index_keys_.size();
+    return true;
+}
+
+void SSTable::LoadLearnedIndex(const Slice &meta, TableIndex *index) const {
+    if (footer_.model_size_ == 0 || index->block_cnt_ == 0) {
+        return;
+    }
+    Slice model = MetaSection(meta, footer_.model_offset_, footer_.model_size_);
+    if (!index->learned_index_.DecodeFrom(model, index->block_cnt_)) {
+        index->learned_index_ = LearnedIndex();
+    }
+}
+
+void SSTable::InstallIndex(std::shared_ptr<const TableIndex> index) const {
+    if (options_.index_cache_) {
+        size_t charge = sizeof(TableIndex) + index->MemoryUsage() + index->filter_data_.capacity();
+        options_.index_cache_->Insert(table_id_.table_id_, std::move(index), charge);
+        return;
+    }
+    resident_holder_ = std::move(index);
+    resident_.store(resident_holder_.get(), std::memory_order_release);
 }
 
-void SSTable::Save(const std::string &content) {
-    std::ofstream ofs(table_id_.path_, std::ios::binary);
-    WriteUint64(ofs, entry_cnt_);
-    for (size_t i = 0; i < entry_cnt_; ++i) {       // 写到文件中
-        WriteUint64(ofs, keys_[i]);
-        WriteUint64(ofs, offsets_[i]);
+const TableIndex &SSTable::AcquireIndex(IndexCache::Index *holder) const {
+    const TableIndex *resident = resident_.load(std::memory_order_acquire);
+    if (resident) {     // 常驻的索引不会被释放,不需要holder
+        return *resident;
     }
-    WriteUint64(ofs, block_cnt_);
-    for (size_t i = 0; i < block_cnt_; ++i) {
-        WriteUint64(ofs, block_offsets_[i]);
+    auto index_cache = options_.index_cache_;
+    if (index_cache && (*holder = index_cache->Lookup(table_id_.table_id_))) {
+        return **holder;
     }
-    WriteString(ofs, content);
-    ofs.close();
+    std::lock_guard<std::mutex> guard(load_mutex_);
+    // 等待锁的时候其他线程可能已经加载完成
+    resident = resident_.load(std::memory_order_acquire);
+    if (resident) {
+        return *resident;
+    }
+    if (index_cache && (*holder = index_cache->Lookup(table_id_.table_id_))) {
+        return **holder;
+    }
+    *holder = LoadTableIndex();
+    InstallIndex(*holder);
+    return **holder;
+}
+
+bool SSTable::ReadFile(uint64_t offset, size_t size, std::string *dst) const {
+    if (mapped_) {
+        if (offset + size > mapped_size_) {
+            return false;
+        }
+        dst->assign(mapped_ + offset, size);
+        return true;
+    }
+    dst->resize(size);
+    return size == 0 || file_.ReadAt(offset, size, &(*dst)[0]);
+}
+
+uint64_t TableIndex::KeyAt(size_t blockno) const {
+    return mapped_index_ ? DecodeFixed64(mapped_index_ + blockno * kRawIndexEntrySize) : index_keys_[blockno];
+}
+
+BlockHandle TableIndex::HandleAt(size_t blockno) const {
+    if (mapped_index_) {
+        const char *entry = mapped_index_ + blockno * kRawIndexEntrySize;
+        return BlockHandle{DecodeFixed64(entry + sizeof(uint64_t)), DecodeFixed64(entry + sizeof(uint64_t) * 2)};
+    }
+    return block_handles_[blockno];
+}
+
+size_t TableIndex::FindBlock(uint64_t key) const {
+    if (!learned_index_.Empty()) {
+        return FindBlockByModel(key);
+    }
+    if (index_searcher_.Size() == block_cnt_ && block_cnt_ > 0) {
+        return index_searcher_.LowerBound(key);
+    }
+    return SearchIndex(key, 0, block_cnt_);
+}
+
+size_t TableIndex::FindBlockByModel(uint64_t key) const {
+    size_t begin, end;
+    learned_index_.Predict(key, &begin, &end);
+    size_t blockno = SearchIndex(key, begin, end);
+    // 模型只影响查找的快慢,结果总是用index中的key验证过的
+    if ((blockno == 0 || KeyAt(blockno - 1) < key) && (blockno == block_cnt_ || KeyAt(blockno) >= key)) {
+        return blockno;
+    }
+    return SearchIndex(key, 0, block_cnt_);
+}
+
+size_t TableIndex::SearchIndex(uint64_t key, size_t left, size_t right) const {
+    while (left < right) {
+        size_t mid = left + (right - left) / 2;
+        if (KeyAt(mid) < key) {
+            left = mid + 1;
+        } else {
+            right = mid;
+        }
+    }
+    return left;
+}
+
+bool SSTable::GetBlockContents(const TableIndex &index, size_t blockno, Slice *contents, BlockCache::Block *holder,
+                               bool fill_cache) const {
+    if (blockno >= index.block_cnt_) {
+        return false;
+    }
+    if (mapped_) {
+        auto handle = index.HandleAt(blockno);
+        if (!IsValidHandle(handle)) {
+            return false;
+        }
+        const char *block = mapped_ + handle.offset_;
+        if (block[0] == kNoCompression) {
+            if (!VerifyMappedBlock(blockno, block, handle.size_)) {
+                return false;
+            }
+            *contents = Slice(block + kBlockHeaderSize, handle.size_ - kBlockHeaderSize - kBlockTrailerSize);
+            return true;
+        }
+        // 压缩过的block需要解压到holder中,没有holder时不能返回它的内容
+        if (!holder) {
+            return false;
+        }
+    }
+    *holder = ReadBlock(index, blockno, fill_cache);
+    if (!*holder) {
+        return false;
+    }
+    *contents = Slice(**holder);
+    return true;
+}
+
+bool SSTable::VerifyMappedBlock(size_t blockno, const char *block, size_t size) const {
+    if (options_.verify_policy_ == kNoVerify) {
+        return true;
+    }
+    if (options_.verify_policy_ == kVerifyAlways || blockno >= block_cnt_) {
+        return BlockChecksumMatch(block, size);
+    }
+    // 映射区域的内容不会改变,校验过一次之后不需要再校验;并发的第一次读取可能各自校验一次
+    auto &word = verified_blocks_[blockno / 64];
+    uint64_t bit = uint64_t(1) << (blockno % 64);
+    if (word.load(std::memory_order_relaxed) & bit) {
+        return true;
+    }
+    if (!BlockChecksumMatch(block, size)) {
+        return false;
+    }
+    word.fetch_or(bit, std::memory_order_relaxed);
+    return true;
+}
+
+BlockCache::Block SSTable::ReadBlock(const TableIndex &index, size_t blockno, bool fill_cache) const {
+    if (blockno >= index.block_cnt_ || (!file_.IsOpen() && !mapped_)) {
+        return nullptr;
+    }
+    auto block_cache = options_.block_cache_;
+    if (block_cache) {
+        auto block = block_cache->Lookup(table_id_.table_id_, blockno);
+        if (block) {
+            return block;
+        }
+    }
+    auto handle = index.HandleAt(blockno);
+    std::string raw, content;
+    if (!IsValidHandle(handle) || !ReadFile(handle.offset_, handle.size_, &raw)) {
+        return nullptr;
+    }
+    // 在解压之前校验,损坏的block不会进入block cache
+    if (options_.verify_policy_ != kNoVerify && !BlockChecksumMatch(raw.data(), raw.size())) {
+        return nullptr;
+    }
+    auto type = static_cast<CompressionType>(raw[0]);
+    raw.resize(raw.size() - kBlockTrailerSize);
+    if (type == kNoCompression) {
+        raw.erase(0, kBlockHeaderSize);
+        content.swap(raw);
+    } else if (!Uncompress(type, raw.data() + kBlockHeaderSize, raw.size() - kBlockHeaderSize, &content)) {
+        return nullptr;
+    }
+    auto block = std::make_shared<const std::string>(std::move(content));
+    if (block_cache && fill_cache) {
+        block_cache->Insert(table_id_.table_id_, blockno, block);
+    }
+    return block;
+}
+
+namespace kvstore {
+
+    // 每次解码一整个block,之后的Next只是移动下标.非mmap模式下文件是随机访问的提示,
+    // 内核不会预读,由迭代器每隔kReadaheadSize发起一次异步预读
+    class SSTableIterator: public Iterator {
+    public:
+        SSTableIterator(const SSTable *table, bool fill_cache):
+                table_(table), table_index_(&table->AcquireIndex(&index_holder_)), fill_cache_(fill_cache) {}
+
+        bool Valid() const override {
+            return ok_ && index_ < keys_.size();
+        }
+
+        void SeekToFirst() override {
+            LoadBlock(0);
+            SkipEmptyBlocks();
+        }
+
+        void Seek(uint64_t key) override {
+            LoadBlock(table_index_->FindBlock(key));
+            index_ = std::lower_bound(keys_.begin(), keys_.end(), key) - keys_.begin();
+            SkipEmptyBlocks();
+        }
+
+        void Next() override {
+            assert(Valid());
+            ++index_;
+            SkipEmptyBlocks();
+        }
+
+        uint64_t Key() const override {
+            return keys_[index_];
+        }
+
+        Slice Value() const override {
+            return values_[index_];
+        }
+
+        bool Ok() const override {
+            return ok_;
+        }
+
+    private:
+        void LoadBlock(size_t blockno) {
+            blockno_ = blockno;
+            index_ = 0;
+            keys_.clear();
+            values_.clear();
+            holder_.reset();
+            if (blockno_ >= table_index_->block_cnt_) {
+                return;
+            }
+            if (!table_->mapped_) {
+                uint64_t offset = table_index_->HandleAt(blockno_).offset_;
+                if (offset < readahead_begin_ || offset >= readahead_end_) {
+                    table_->file_.Readahead(offset, kReadaheadSize);
+                    readahead_begin_ = offset;
+                    readahead_end_ = offset + kReadaheadSize;
+                }
+            }
+            Slice contents;
+            // 损坏的block会让迭代器停止,而不是跳过其中的数据
+            ok_ = table_->GetBlockContents(*table_index_, blockno_, &contents, &holder_, fill_cache_)
+                  && BlockReader(contents, table_->footer_.format_).DecodeEntries(&keys_, &values_);
+        }
+
+        void SkipEmptyBlocks() {
+            while (ok_ && index_ >= keys_.size() && blockno_ < table_index_->block_cnt_) {
+                LoadBlock(blockno_ + 1);
+            }
+        }
+
+        static constexpr size_t kReadaheadSize = 256 * 1024;
+
+        const SSTable *table_;
+        IndexCache::Index index_holder_;        // 迭代器存在期间索引不会被释放
+        const TableIndex *table_index_;
+        bool fill_cache_;
+        bool ok_{true};
+        size_t blockno_{0};
+        BlockCache::Block holder_;
+        std::vector<uint64_t> keys_;
+        std::vector<Slice> values_;
+        size_t index_{0};
+        uint64_t readahead_begin_{0};
+        uint64_t readahead_end_{0};
+    };
+
+}
+
+std::unique_ptr<Iterator> SSTable::NewIterator(bool fill_cache) const {
+    return std::unique_ptr<Iterator>(new SSTableIterator(this, fill_cache));
+}
+
+namespace {
+
+    class LevelIterator: public Iterator {
+    public:
+        LevelIterator(std::vector<std::shared_ptr<SSTable>> tables, bool fill_cache):
+                tables_(std::move(tables)), fill_cache_(fill_cache), table_index_(tables_.size()) {}
+
+        bool Valid() const override {
+            return table_iter_ && table_iter_->Valid();
+        }
+
+        void SeekToFirst() override {
+            OpenTable(0);
+            if (table_iter_) {
+                table_iter_->SeekToFirst();
+            }
+            SkipEmptyTables();
+        }
+
+        void Seek(uint64_t key) override {
+            // 第一个最大的key不小于key的表
+            auto it = std::lower_bound(tables_.begin(), tables_.end(), key,
+                                       [](const std::shared_ptr<SSTable> &table, uint64_t k) {
+                                           return table->GetLargestKey() < k;
+                                       });
+            OpenTable(it - tables_.begin());
+            if (table_iter_) {
+                table_iter_->Seek(key);
+            }
+            SkipEmptyTables();
+        }
+
+        void Next() override {
+            assert(Valid());
+            table_iter_->Next();
+            SkipEmptyTables();
+        }
+
+        uint64_t Key() const override {
+            return table_iter_->Key();
+        }
+
+        Slice Value() const override {
+            return table_iter_->Value();
+        }
+
+        bool Ok() const override {
+            return !table_iter_ || table_iter_->Ok();
+        }
+
+    private:
+        void OpenTable(size_t table_index) {
+            table_index_ = table_index;
+            table_iter_ = table_index_ < tables_.size() ? tables_[table_index_]->NewIterator(fill_cache_) : nullptr;
+        }
+
+        void SkipEmptyTables() {
+            while (table_iter_ && !table_iter_->Valid() && table_iter_->Ok()) {
+                OpenTable(table_index_ + 1);
+                if (table_iter_) {
+                    table_iter_->SeekToFirst();
+                }
+            }
+        }
+
+        std::vector<std::shared_ptr<SSTable>> tables_;
+        bool fill_cache_;
+        size_t table_index_;
+        std::unique_ptr<Iterator> table_iter_;
+    };
+
+}
+
+std::unique_ptr<Iterator> kvstore::NewLevelIterator(std::vector<std::shared_ptr<SSTable>> tables, bool fill_cache) {
+    return std::unique_ptr<Iterator>(new LevelIterator(std::move(tables), fill_cache));
 }
@@ -4,7 +4,19 @@
 #ifndef KVSTORE_SSTABLE_H
 #define KVSTORE_SSTABLE_H
 
+#include <atomic>
 #include <memory>
+#include <mutex>
+#include "Block.h"
+#include "BlockCache.h"
+#include "BloomFilter.h"
+#include "Compression.h"
+#include "DiskStorage.h"
+#include "IndexCache.h"
+#include "Iterator.h"
+#include "KeySearch.h"
+#include "LearnedIndex.h"
+#include "Slice.h"
 #include "SkipList.h"
 
 namespace kvstore {
@@ -15,35 +27,263 @@ namespace kvstore {
         std::string path_;
     };
 
+    // 构建SSTable时的fsync策略
+    enum SyncPolicy {
+        kNoSync = 0,            // 交给操作系统决定什么时候落盘
+        kSyncOnFinish = 1,      // 写完footer之后fsync一次
+        kSyncOnFlush = 2,       // 写缓冲区每次写入文件之后都fdatasync,脏页不会堆积
+    };
+
+    // 读取data block时的校验策略,footer自身的校验和总是会检查
+    enum VerifyPolicy {
+        kNoVerify = 0,          // 不校验data block,打开时也不校验filter和index
+        kVerifyOnFill = 1,      // block从文件读进内存(填充block cache)时校验,mmap模式下每个block在第一次零拷贝读取时校验
+        kVerifyAlways = 2,      // mmap模式下每次零拷贝的读取都校验
+    };
+
+    struct SSTableOptions {
+        BlockCache *block_cache_{nullptr};      // 为nullptr时每次读取都直接访问文件
+        bool use_mmap_{false};                  // 把整个文件映射到内存中,索引原地读取,value可以零拷贝地返回
+        bool sequential_access_{false};         // 给内核的访问模式提示,默认是随机访问,迭代器自己预读后面的block
+        int bloom_bits_per_key_{10};            // 构建SSTable时Bloom filter每个key使用的bit数,为0时不生成
+        BlockFormat format_{kRawFormat};        // 构建SSTable时使用的格式,读取时以footer中记录的为准
+        size_t write_buffer_size_{1024 * 1024}; // 构建SSTable时的写缓冲区大小,按block大小向上对齐
+        bool direct_io_{false};                 // 构建SSTable时使用O_DIRECT写文件,flush和合并的输出不占用page cache
+        SyncPolicy sync_policy_{kNoSync};
+        CompressionType compression_{kNoCompression};   // 压缩之后小于原来的7/8才保存压缩的版本
+        SearchLayout index_layout_{kAutoLayout};        // 常驻内存的index在打开时重新排列成这种布局
+        size_t learned_index_error_{0};     // 构建SSTable时为index拟合learned index的最大误差,为0时不生成
+        VerifyPolicy verify_policy_{kVerifyOnFill};     // 校验失败的block当作读取失败,filter和index校验失败时当作空表
+        IndexCache *index_cache_{nullptr};      // 为nullptr时filter和index加载之后一直常驻内存,否则由它决定何时淘汰
+    };
+
+    // 不读取文件就能打开SSTable所需的信息,由manifest保存.footer中有entry数量,最小的key以及filter和index的位置
+    struct TableProperties {
+        uint64_t file_size_{0};
+        uint64_t largest_key_{0};
+        uint64_t block_cnt_{0};
+        Footer footer_;
+    };
+
+    // SSTable的filter和index,打开时或者第一次访问时从文件中加载,创建之后不再修改
+    struct TableIndex {
+        size_t block_cnt_{0};
+        const char *mapped_index_{nullptr};     // kRawFormat的mmap模式下文件中的index
+        std::vector<uint64_t> index_keys_;      // 每个block的最后一个key,index原地读取时为空
+        std::vector<BlockHandle> block_handles_;
+        KeySearcher index_searcher_;        // index_keys_的查找布局,kSortedLayout或者有learned index时不建立
+        LearnedIndex learned_index_;
+        std::string filter_data_;       // 非mmap模式下filter_指向这里
+        Slice filter_;
+
+        uint64_t KeyAt(size_t blockno) const;
+
+        BlockHandle HandleAt(size_t blockno) const;
+
+        // 返回可能包含key的block,即最后一个key不小于key的第一个block
+        size_t FindBlock(uint64_t key) const;
+
+        // 只在learned index预测的窗口中查找,窗口边界不满足lower bound的条件时退回到全局查找
+        size_t FindBlockByModel(uint64_t key) const;
+
+        // 在[left, right)中二分查找第一个最后一个key不小于key的block
+        size_t SearchIndex(uint64_t key, size_t left, size_t right) const;
+
+        // 不包括filter,kRawFormat的mmap模式下index在映射区域中,不计算在内
+        size_t MemoryUsage() const {
+            return index_keys_.capacity() * sizeof(uint64_t) + block_handles_.capacity() * sizeof(BlockHandle)
+                   + index_searcher_.MemoryUsage() + learned_index_.MemoryUsage();
+        }
+    };
+
+    // 文件格式: [data block]*n [filter] [learned index] [index] [footer].
+    // data block的头部是压缩类型,后面是压缩之后的内容,尾部是CRC32C,解压之后保存key和value,格式见BlockBuilder;index中每个block一项,记录block的最后一个key和BlockHandle,
+    // 编码方式见EncodeIndex;learned index是可选的,拟合的是index中的key到block下标的映射,见LearnedIndex;footer定长,见Footer.文件由SSTableBuilder生成
     class SSTable {
     public:
 
+        friend class SSTableIterator;
+
         using KvContainer = SkipList<uint64_t, std::string>;
 
         using KvIterator = SkipListIterator<uint64_t, std::string>;
 
         using MemStore = std::unique_ptr<KvContainer>;
 
-        explicit SSTable(const SSTableId &tableId);
+        explicit SSTable(const SSTableId &tableId, const SSTableOptions &options = SSTableOptions());
+
+        // 构建失败时Ok()返回false,此时表是空的
+        explicit SSTable(const KvContainer &sklist, const SSTableId &tableId,
+                         const SSTableOptions &options = SSTableOptions());
 
-        explicit SSTable(const KvContainer &sklist, const SSTableId &tableId);
+        // 使用manifest中记录的信息打开,不读取footer,filter和index,它们在第一次访问时才加载
+        SSTable(const SSTableId &tableId, const TableProperties &properties,
+                const SSTableOptions &options = SSTableOptions());
 
+        ~SSTable();
+
+        SSTable(const SSTable &sstable) = delete;
+
+        SSTable& operator=(const SSTable &sstable) = delete;
+
+        // key保存在block中,即使load为false也需要读取block才能确定key是否存在
         bool Get(uint64_t key, std::string *value, bool load) const;
 
+        // mmap模式下没有压缩的block直接返回指向映射区域的value,不拷贝也没有系统调用,返回的Slice在SSTable析构之前有效.
+        // 其他情况下value指向holder中解压或者读取出来的block,在holder释放之前有效;holder为nullptr时这些情况返回false
+        bool Get(uint64_t key, Slice *value, BlockCache::Block *holder = nullptr) const;
+
         bool Insert(uint64_t key, const std::string &value);
 
+        // 从跳表构建时写文件或者重新打开失败返回false,其他方式打开的表总是返回true
+        bool Ok() const {
+            return ok_;
+        }
+
+        // 只查询Bloom filter,返回false时key一定不在这个SSTable中
+        bool KeyMayMatch(uint64_t key) const;
+
         bool LoadBlock(size_t blockno, std::string *value) const;
 
+        // 遍历整个表,迭代器使用期间SSTable必须有效.fill_cache为false时读取的block不放入block cache,
+        // 用于compaction这样的一次性扫描
+        std::unique_ptr<Iterator> NewIterator(bool fill_cache = true) const;
+
+        const SSTableId &GetId() const {
+            return table_id_;
+        }
+
+        size_t GetEntryCount() const {
+            return entry_cnt_;
+        }
+
+        size_t GetBlockCount() const {
+            return block_cnt_;
+        }
+
+        // 空表的key范围没有意义,key范围不需要加载index
+        uint64_t GetSmallestKey() const {
+            return footer_.smallest_key_;
+        }
+
+        uint64_t GetLargestKey() const {
+            return largest_key_;
+        }
+
+        // 写入manifest的信息,用来在下次启动时延迟打开
+        TableProperties GetProperties() const;
+
+        // 把每个block的最后一个key追加到keys中,相邻的两个key之间大约是一个block的数据
+        void GetIndexKeys(std::vector<uint64_t> *keys) const;
+
+        uint64_t GetFileSize() const {
+            return file_size_;
+        }
+
+        BlockFormat GetFormat() const {
+            return footer_.format_;
+        }
+
+        // 以下三个函数会在索引没有加载时加载它
+        size_t GetFilterSize() const;
+
+        // 常驻内存的索引大小,kRawFormat的mmap模式下索引在映射区域中,不计算在内
+        size_t GetIndexMemoryUsage() const;
+
+        // learned index的段数,文件中没有learned index时为0
+        size_t GetLearnedSegmentCount() const;
+
+        // filter和index当前是否在内存中
+        bool IsIndexLoaded() const;
+
+        // 没有加载时立即加载filter和index,它们所在的区域只需要一次读取
+        void PreloadIndex() const;
+
+        bool IsMapped() const {
+            return mapped_ != nullptr;
+        }
+
+        // 在随机访问(点查)和顺序访问(扫描整个表)之间切换madvise或者fadvise的提示
+        void AdviseAccess(bool sequential);
+
+        // 被compaction替换之后调用,最后一个引用释放时删除文件
+        void MarkObsolete() {
+            obsolete_.store(true, std::memory_order_relaxed);
+        }
+
     private:
-        void Save(const std::string &content);
+        // 打开文件,读取footer,filter和index
+        void OpenForRead();
+
+        // 打开文件并获取文件大小,mmap模式下建立映射
+        bool OpenFile();
+
+        void MapFile(size_t file_size);
+
+        // 解析文件末尾的footer,文件不完整时返回false
+        bool ReadFooter(uint64_t file_size);
+
+        // 一次读取filter,learned index和index所在的连续区域并校验,mmap模式下直接指向映射区域
+        bool ReadMeta(std::string *scratch, Slice *meta) const;
+
+        // meta中文件位置[offset, offset + size)的部分
+        Slice MetaSection(const Slice &meta, uint64_t offset, uint64_t size) const;
+
+        // 读取并解码filter和index,文件损坏时返回空的索引,不会返回nullptr
+        std::shared_ptr<TableIndex> LoadTableIndex() const;
+
+        void LoadFilter(const Slice &meta, TableIndex *index) const;
+
+        bool LoadIndex(const Slice &meta, TableIndex *index) const;
+
+        // 读取learned index,文件中没有或者数据不完整时查找退回到index_searcher_和二分查找
+        void LoadLearnedIndex(const Slice &meta, TableIndex *index) const;
+
+        // 常驻的索引放在resident_中,否则放进index_cache_
+        void InstallIndex(std::shared_ptr<const TableIndex> index) const;
+
+        // 返回当前的索引,没有加载时从文件中加载.holder在使用索引期间持有它,避免被并发地淘汰
+        const TableIndex &AcquireIndex(IndexCache::Index *holder) const;
+
+        // 把文件中[offset, offset + size)的内容读到dst中,mmap模式下直接拷贝映射区域
+        bool ReadFile(uint64_t offset, size_t size, std::string *dst) const;
+
+        // mmap模式下没有压缩的block直接指向映射区域,否则指向holder中解压之后的block
+        bool GetBlockContents(const TableIndex &index, size_t blockno, Slice *contents, BlockCache::Block *holder,
+                              bool fill_cache = true) const;
+
+        // handle必须完整地位于filter之前的data block区域中,损坏或者过期的index不会导致越界或者任意大小的读取
+        bool IsValidHandle(const BlockHandle &handle) const {
+            return handle.size_ >= kBlockHeaderSize + kBlockTrailerSize && handle.offset_ <= footer_.filter_offset_
+                   && handle.size_ <= footer_.filter_offset_ - handle.offset_;
+        }
+
+        // mmap模式下零拷贝读取的block,kVerifyOnFill下校验通过的block记录在verified_blocks_中,不再重复校验
+        bool VerifyMappedBlock(size_t blockno, const char *block, size_t size) const;
+
+        // 读取并解压第blockno个block,优先从block cache中获取,fill_cache为false时不放入block cache
+        BlockCache::Block ReadBlock(const TableIndex &index, size_t blockno, bool fill_cache = true) const;
 
         SSTableId table_id_;
+        SSTableOptions options_;
+        DiskStorage file_;      // mmap模式下建立映射之后关闭
+        const char *mapped_{nullptr};
+        size_t mapped_size_{0};
+        std::unique_ptr<std::atomic<uint64_t>[]> verified_blocks_;      // mmap模式下每个block一位
+        uint64_t file_size_{0};
+        Footer footer_;
         size_t entry_cnt_{0};
         size_t block_cnt_{0};
-        std::vector<uint64_t> keys_;
-        std::vector<uint64_t> offsets_;
-        std::vector<uint64_t> block_offsets_;
+        uint64_t largest_key_{0};
+        mutable std::mutex load_mutex_;     // 同一个表的索引只由一个线程加载
+        mutable std::shared_ptr<const TableIndex> resident_holder_;
+        mutable std::atomic<const TableIndex *> resident_{nullptr};     // 设置之后不再改变,读取时不需要加锁
+        std::atomic<bool> obsolete_{false};
+        bool ok_{true};
     };
+
+    // 依次遍历按key范围排好序并且互不重叠的一组SSTable,同一时间只打开其中一个表的迭代器
+    std::unique_ptr<Iterator> NewLevelIterator(std::vector<std::shared_ptr<SSTable>> tables, bool fill_cache = true);
 }
 
 #endif //KVSTORE_SSTABLE_H
@@ -0,0 +1,126 @@
+//
+// Created by 杨丰硕 on 2023/3/24.
+//
+#include <unistd.h>
+#include "SSTableBuilder.h"
+#include "Compression.h"
+#include "Crc32c.h"
+#include "Coding.h"
+
+using namespace kvstore;
+
+SSTableBuilder::SSTableBuilder(const std::string &path, const SSTableOptions &options):
+        path_(path), options_(options), block_(options.format_), filter_(options.bloom_bits_per_key_) {
+    FileOptions file_options;
+    file_options.buffer_size_ = options_.write_buffer_size_;
+    file_options.direct_io_ = options_.direct_io_;
+    file_options.sync_on_write_ = options_.sync_policy_ == kSyncOnFlush;
+    ok_ = file_.OpenForWrite(path_, true, file_options);
+}
+
+SSTableBuilder::~SSTableBuilder() {
+    if (!finished_) {
+        Abandon();
+    }
+}
+
+bool SSTableBuilder::Add(uint64_t key, const Slice &value) {
+    if (!ok_ || finished_) {
+        return false;
+    }
+    if (entry_cnt_ == 0) {
+        smallest_key_ = key;
+    }
+    block_.Add(key, value);
+    if (options_.bloom_bits_per_key_ > 0) {
+        filter_.AddKey(key);
+    }
+    ++entry_cnt_;
+    if (block_.EstimatedSize() >= DiskStorage::BLOCK_SIZE) {
+        FlushBlock();
+    }
+    return ok_;
+}
+
+bool SSTableBuilder::Finish() {
+    if (!ok_ || finished_) {
+        return false;
+    }
+    if (!block_.Empty()) {
+        FlushBlock();
+    }
+    Footer footer;
+    footer.entry_cnt_ = entry_cnt_;
+    footer.smallest_key_ = smallest_key_;
+    footer.format_ = options_.format_;
+    footer.filter_offset_ = offset_;
+    if (options_.bloom_bits_per_key_ > 0) {
+        std::string filter = filter_.Finish();
+        footer.filter_size_ = filter.size();
+        footer.meta_crc_ = ExtendCrc32c(footer.meta_crc_, filter.data(), filter.size());
+        Append(filter);
+    }
+    footer.model_offset_ = offset_;
+    if (options_.learned_index_error_ > 0 && !index_keys_.empty()) {
+        LearnedIndex learned_index;
+        learned_index.Build(index_keys_, options_.learned_index_error_);
+        std::string model;
+        learned_index.EncodeTo(&model);
+        footer.model_size_ = model.size();
+        footer.meta_crc_ = ExtendCrc32c(footer.meta_crc_, model.data(), model.size());
+        Append(model);
+    }
+    std::string index;
+    EncodeIndex(options_.format_, index_keys_, block_handles_, &index);
+    footer.index_offset_ = offset_;
+    footer.index_size_ = index.size();
+    footer.meta_crc_ = ExtendCrc32c(footer.meta_crc_, index.data(), index.size());
+    Append(index);
+    std::string encoded_footer;
+    footer.EncodeTo(&encoded_footer);
+    Append(encoded_footer);
+    ok_ = ok_ && (options_.sync_policy_ == kNoSync ? file_.Flush() : file_.Sync());
+    ok_ = file_.Close() && ok_;
+    finished_ = true;
+    if (!ok_) {
+        ::unlink(path_.c_str());
+    }
+    return ok_;
+}
+
+void SSTableBuilder::Abandon() {
+    file_.Close();
+    ::unlink(path_.c_str());
+    finished_ = true;
+}
+
+void SSTableBuilder::FlushBlock() {
+    uint64_t last_key = block_.LastKey();
+    std::string contents = block_.Finish();
+    auto type = options_.compression_;
+    compressed_.clear();
+    // 压缩效果不明显的block保存原始内容,读取时省掉解压
+    if (type == kNoCompression || !Compress(type, contents.data(), contents.size(), &compressed_)
+        || compressed_.size() >= contents.size() - contents.size() / 8) {
+        type = kNoCompression;
+    } else {
+        ++compressed_block_cnt_;
+    }
+    const std::string &payload = type == kNoCompression ? contents : compressed_;
+    index_keys_.push_back(last_key);
+    block_handles_.push_back(BlockHandle{offset_, kBlockHeaderSize + payload.size() + kBlockTrailerSize});
+    char header = static_cast<char>(type);
+    char trailer[kBlockTrailerSize];
+    EncodeFixed32(trailer, ExtendCrc32c(Crc32c(&header, kBlockHeaderSize), payload.data(), payload.size()));
+    Append(&header, kBlockHeaderSize);
+    Append(payload);
+    Append(trailer, kBlockTrailerSize);
+}
+
+bool SSTableBuilder::Append(const char *data, size_t size) {
+    if (ok_) {
+        ok_ = file_.Append(data, size);
+        offset_ += size;
+    }
+    return ok_;
+}
@@ -0,0 +1,90 @@
+//
+// Created by 杨丰硕 on 2023/3/24.
+//
+
+#ifndef KVSTORE_SSTABLEBUILDER_H
+#define KVSTORE_SSTABLEBUILDER_H
+
+#include <memory>
+#include "Block.h"
+#include "BloomFilter.h"
+#include "DiskStorage.h"
+#include "SSTable.h"
+
+namespace kvstore {
+
+    // 流式地构建SSTable文件,每个block写满之后立即追加到DiskStorage对齐的写缓冲区中,缓冲区满了才写入文件.
+    // 常驻内存只有当前block,写缓冲区,index和filter,和整个表的大小无关.
+    // 没有调用Finish就析构时会删除写了一半的文件
+    class SSTableBuilder {
+    public:
+        SSTableBuilder(const std::string &path, const SSTableOptions &options);
+
+        ~SSTableBuilder();
+
+        SSTableBuilder(const SSTableBuilder &builder) = delete;
+
+        SSTableBuilder& operator=(const SSTableBuilder &builder) = delete;
+
+        // key必须严格递增,写文件失败之后返回false,之后的调用都会被忽略
+        bool Add(uint64_t key, const Slice &value);
+
+        bool Add(uint64_t key, const std::string &value) {
+            return Add(key, Slice(value));
+        }
+
+        // 写入最后一个block,filter,learned index,index和footer,并按照sync_policy_决定是否fsync
+        bool Finish();
+
+        // 放弃构建并删除文件
+        void Abandon();
+
+        bool Ok() const {
+            return ok_;
+        }
+
+        size_t GetEntryCount() const {
+            return entry_cnt_;
+        }
+
+        size_t GetBlockCount() const {
+            return block_handles_.size();
+        }
+
+        size_t GetCompressedBlockCount() const {
+            return compressed_block_cnt_;
+        }
+
+        // 已经追加的字节数,包括还在写缓冲区中的部分
+        uint64_t GetFileSize() const {
+            return offset_;
+        }
+
+    private:
+        void FlushBlock();
+
+        bool Append(const char *data, size_t size);
+
+        bool Append(const std::string &data) {
+            return Append(data.data(), data.size());
+        }
+
+        std::string path_;
+        SSTableOptions options_;
+        DiskStorage file_;
+        BlockBuilder block_;
+        BloomFilter filter_;
+        std::vector<uint64_t> index_keys_;
+        std::vector<BlockHandle> block_handles_;
+        std::string compressed_;        // 复用压缩block的缓冲区
+        size_t compressed_block_cnt_{0};
+        uint64_t offset_{0};
+        size_t entry_cnt_{0};
+        uint64_t smallest_key_{0};
+        bool ok_{true};
+        bool finished_{false};
+    };
+
+}
+
+#endif //KVSTORE_SSTABLEBUILDER_H
@@ -0,0 +1,135 @@
+//
+// Created by 杨丰硕 on 2023/3/18.
+//
+#include <algorithm>
+#include "ShardedSkipList.h"
+using namespace kvstore;
+
+template<class KEY, class VALUE, class COMPARATOR>
+ShardedSkipList<KEY, VALUE, COMPARATOR>::ShardedSkipList(size_t shard_cnt, Comparator comparator, bool use_arena):
+        compare_(std::move(comparator)) {
+    assert(shard_cnt > 0);
+    InitShards(shard_cnt, use_arena);
+}
+
+template<class KEY, class VALUE, class COMPARATOR>
+ShardedSkipList<KEY, VALUE, COMPARATOR>::ShardedSkipList(const std::vector<KEY> &split_keys,
+                                                         Comparator comparator, bool use_arena):
+        compare_(std::move(comparator)), split_keys_(split_keys) {
+    assert(!split_keys_.empty());
+    InitShards(split_keys_.size() + 1, use_arena);
+}
+
+template<class KEY, class VALUE, class COMPARATOR>
+void ShardedSkipList<KEY, VALUE, COMPARATOR>::InitShards(size_t shard_cnt, bool use_arena) {
+    shards_.reserve(shard_cnt);
+    for (size_t i = 0; i < shard_cnt; ++i) {
+        shards_.emplace_back(new Shard(compare_, use_arena));
+    }
+}
+
+template<class KEY, class VALUE, class COMPARATOR>
+bool ShardedSkipList<KEY, VALUE, COMPARATOR>::Put(const KEY &key, const VALUE &value) {
+    auto &shard = shards_[GetShardIndex(key)];
+    std::lock_guard<std::shared_timed_mutex> guard(shard->mutex_);
+    return shard->table_.Put(key, value);
+}
+
+template<class KEY, class VALUE, class COMPARATOR>
+bool ShardedSkipList<KEY, VALUE, COMPARATOR>::Get(const KEY &key, VALUE *value) const {
+    auto &shard = shards_[GetShardIndex(key)];
+    std::shared_lock<std::shared_timed_mutex> guard(shard->mutex_);
+    return shard->table_.Get(key, value);
+}
+
+template<class KEY, class VALUE, class COMPARATOR>
+bool ShardedSkipList<KEY, VALUE, COMPARATOR>::Delete(const KEY &key) {
+    auto &shard = shards_[GetShardIndex(key)];
+    std::lock_guard<std::shared_timed_mutex> guard(shard->mutex_);
+    return shard->table_.Delete(key);
+}
+
+template<class KEY, class VALUE, class COMPARATOR>
+void ShardedSkipList<KEY, VALUE, COMPARATOR>::Dump() {
+    for (size_t i = 0; i < shards_.size(); ++i) {
+        std::cout << "shard " << i << ":\n";
+        std::lock_guard<std::shared_timed_mutex> guard(shards_[i]->mutex_);
+        shards_[i]->table_.Dump();
+    }
+}
+
+template<class KEY, class VALUE, class COMPARATOR>
+size_t ShardedSkipList<KEY, VALUE, COMPARATOR>::GetShardIndex(const KEY &key) const {
+    if (split_keys_.empty()) {
+        // 打散hash值,避免std::hash对整数是恒等映射时连续的key只落在低位相同的分片中
+        uint64_t hash = static_cast<uint64_t>(std::hash<KEY>()(key)) * 0x9e3779b97f4a7c15ULL;
+        return (hash >> 32) % shards_.size();
+    }
+    auto it = std::upper_bound(split_keys_.begin(), split_keys_.end(), key,
+                               [this](const KEY &a, const KEY &b) { return compare_(a, b) < 0; });
+    return it - split_keys_.begin();
+}
+
+template<class KEY, class VALUE, class COMPARATOR>
+ShardedSkipListIterator<KEY, VALUE, COMPARATOR>::ShardedSkipListIterator(const ConstSkipList &skiplist):
+        skip_list_(skiplist) {
+    for (auto &shard : skip_list_.shards_) {
+        shard->mutex_.lock_shared();
+        shard_iterators_.emplace_back(new ShardIterator(shard->table_));
+    }
+}
+
+template<class KEY, class VALUE, class COMPARATOR>
+ShardedSkipListIterator<KEY, VALUE, COMPARATOR>::~ShardedSkipListIterator() {
+    for (auto &shard : skip_list_.shards_) {
+        shard->mutex_.unlock_shared();
+    }
+}
+
+template<class KEY, class VALUE, class COMPARATOR>
+const Node<KEY, VALUE>* ShardedSkipListIterator<KEY, VALUE, COMPARATOR>::SeekToFirst() {
+    heap_.clear();
+    for (size_t i = 0; i < shard_iterators_.size(); ++i) {
+        auto node = shard_iterators_[i]->SeekToFirst();
+        if (node) {
+            heap_.emplace_back(node, i);
+        }
+    }
+    BuildHeap();
+    return Curr();
+}
+
+template<class KEY, class VALUE, class COMPARATOR>
+const Node<KEY, VALUE>* ShardedSkipListIterator<KEY, VALUE, COMPARATOR>::Seek(const KEY &key) {
+    heap_.clear();
+    for (size_t i = 0; i < shard_iterators_.size(); ++i) {
+        auto node = shard_iterators_[i]->Seek(key);
+        if (node) {
+            heap_.emplace_back(node, i);
+        }
+    }
+    BuildHeap();
+    return Curr();
+}
+
+template<class KEY, class VALUE, class COMPARATOR>
+const Node<KEY, VALUE>* ShardedSkipListIterator<KEY, VALUE, COMPARATOR>::Next() {
+    assert(Valid());
+    auto greater = [this](const HeapEntry &a, const HeapEntry &b) { return HeapGreater(a, b); };
+    std::pop_heap(heap_.begin(), heap_.end(), greater);
+    auto shard_index = heap_.back().second;
+    auto node = shard_iterators_[shard_index]->Next();
+    if (node) {     // 分片中的下一个结点重新放入堆中
+        heap_.back().first = node;
+        std::push_heap(heap_.begin(), heap_.end(), greater);
+    } else {
+        heap_.pop_back();
+    }
+    return Curr();
+}
+
+template<class KEY, class VALUE, class COMPARATOR>
+void ShardedSkipListIterator<KEY, VALUE, COMPARATOR>::BuildHeap() {
+    std::make_heap(heap_.begin(), heap_.end(),
+                   [this](const HeapEntry &a, const HeapEntry &b) { return HeapGreater(a, b); });
+}
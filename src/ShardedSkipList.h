@@ -0,0 +1,127 @@
+//
+// Created by 杨丰硕 on 2023/3/18.
+//
+
+#ifndef KVSTORE_SHARDEDSKIPLIST_H
+#define KVSTORE_SHARDEDSKIPLIST_H
+
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <vector>
+#include "SkipList.h"
+
+namespace kvstore {
+
+    template<class KEY, class VALUE, class COMPARATOR>
+    class ShardedSkipListIterator;
+
+    // 把key按hash或者按范围分到多个独立的跳表中,每个分片有自己的读写锁,
+    // 不同分片上的读写可以并行进行
+    template<class KEY, class VALUE, class COMPARATOR = DefaultComparator<KEY>>
+    class ShardedSkipList: public KvContainer<KEY, VALUE> {
+    public:
+
+        friend class ShardedSkipListIterator<KEY, VALUE, COMPARATOR>;
+
+        using Table = SkipList<KEY, VALUE, COMPARATOR>;
+
+        using Comparator = COMPARATOR;
+
+        // 按hash分片
+        explicit ShardedSkipList(size_t shard_cnt, Comparator comparator = Comparator(), bool use_arena = false);
+
+        // 按范围分片,split_keys必须递增,第i个分片保存[split_keys[i-1], split_keys[i])中的key
+        explicit ShardedSkipList(const std::vector<KEY> &split_keys,
+                                 Comparator comparator = Comparator(), bool use_arena = false);
+
+        ~ShardedSkipList() = default;
+
+        ShardedSkipList(const ShardedSkipList &skipList) = delete;
+
+        ShardedSkipList& operator=(const ShardedSkipList &skipList) = delete;
+
+        bool Put(const KEY &key, const VALUE &value) override;
+
+        bool Get(const KEY &key, VALUE *value) const override;
+
+        bool Delete(const KEY &key) override;
+
+        void Dump() override;
+
+        ContainType GetType() override {
+            return SKIPLIST_CTYPE;
+        }
+
+        size_t GetShardCount() const {
+            return shards_.size();
+        }
+
+    private:
+        struct Shard {
+            explicit Shard(const Comparator &comparator, bool use_arena): table_(comparator, use_arena) {}
+
+            mutable std::shared_timed_mutex mutex_;
+            Table table_;
+        };
+
+        size_t GetShardIndex(const KEY &key) const;
+
+        void InitShards(size_t shard_cnt, bool use_arena);
+
+        Comparator compare_;
+        std::vector<KEY> split_keys_;       // 为空时按hash分片
+        std::vector<std::unique_ptr<Shard>> shards_;
+    };
+
+    // 按key的顺序合并所有分片. 迭代器在整个生命周期内持有所有分片的读锁,
+    // 看到的是一个一致的快照,同时会阻塞写者,所以不应该长时间持有
+    template<class KEY, class VALUE, class COMPARATOR = DefaultComparator<KEY>>
+    class ShardedSkipListIterator {
+    public:
+        using ConstNodePtr = const Node<KEY, VALUE>*;
+
+        using ConstSkipList = const ShardedSkipList<KEY, VALUE, COMPARATOR>;
+
+        explicit ShardedSkipListIterator(const ConstSkipList &skiplist);
+
+        ~ShardedSkipListIterator();
+
+        ShardedSkipListIterator(const ShardedSkipListIterator &iterator) = delete;
+
+        ShardedSkipListIterator& operator=(const ShardedSkipListIterator &iterator) = delete;
+
+        ConstNodePtr SeekToFirst();
+
+        ConstNodePtr Seek(const KEY &key);
+
+        ConstNodePtr Next();
+
+        bool Valid() const {
+            return !heap_.empty();
+        }
+
+        ConstNodePtr Curr() const {
+            return heap_.empty() ? nullptr : heap_.front().first;
+        }
+
+    private:
+        using ShardIterator = SkipListIterator<KEY, VALUE, COMPARATOR>;
+
+        using HeapEntry = std::pair<ConstNodePtr, size_t>;      // 分片当前的结点和分片的下标
+
+        void BuildHeap();
+
+        bool HeapGreater(const HeapEntry &a, const HeapEntry &b) const {
+            return skip_list_.compare_(a.first->key_, b.first->key_) > 0;
+        }
+
+        ConstSkipList &skip_list_;
+        std::vector<std::unique_ptr<ShardIterator>> shard_iterators_;
+        std::vector<HeapEntry> heap_;       // 以key为序的小根堆,堆顶是当前结点
+    };
+
+}
+
+#endif //KVSTORE_SHARDEDSKIPLIST_H
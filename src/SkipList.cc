@@ -1,11 +1,19 @@
 //
 // Created by 杨丰硕 on 2023/3/1.
 //
+#include <algorithm>
 #include "SkipList.h"
 using namespace kvstore;
 
-template<class KEY, class VALUE>
-bool SkipList<KEY, VALUE>::Put(const KEY &key, const VALUE &value) {
+template<class KEY, class VALUE, class COMPARATOR>
+bool SkipList<KEY, VALUE, COMPARATOR>::Put(const KEY &key, const VALUE &value) {
+    if (index_) {       // 已经存在的key不需要在跳表中查找
+        auto findit = index_->find(key);
+        if (findit != index_->end()) {
+            findit->second->value_ = value;
+            return true;
+        }
+    }
 
     NodePtr prenodes[kMaxHeight] = {nullptr};
 
@@ -23,8 +31,7 @@ bool SkipList<KEY, VALUE>::Put(const KEY &key, const VALUE &value) {
         curr_height_ = newheight;
     }
     // 创建一个新结点
-    newnode = new Node<KEY, VALUE>(key, value, kMaxHeight);
-    newnode->ResizeNext(newheight);
+    newnode = NewNode(key, value, newheight);
 
     for (int i = 0; i < newheight; ++i) {
         newnode->SetNext(i, prenodes[i]->GetNext(i));
@@ -34,8 +41,85 @@ bool SkipList<KEY, VALUE>::Put(const KEY &key, const VALUE &value) {
     return true;
 }
 
-template<class KEY, class VALUE>
-bool SkipList<KEY, VALUE>::Delete(const KEY &key) {
+template<class KEY, class VALUE, class COMPARATOR>
+size_t SkipList<KEY, VALUE, COMPARATOR>::PutBatch(std::vector<std::pair<KEY, VALUE>> &kvs) {
+    std::stable_sort(kvs.begin(), kvs.end(), [this](const std::pair<KEY, VALUE> &a, const std::pair<KEY, VALUE> &b) {
+        return Less(a.first, b.first);
+    });
+
+    NodePtr prenodes[kMaxHeight];
+    for (int i = 0; i < kMaxHeight; ++i) {
+        prenodes[i] = header_;
+    }
+    NodePtr last_node = nullptr;
+    for (auto &kv : kvs) {
+        if (last_node && Equal(last_node->key_, kv.first)) {       // 排序之后相同的key是相邻的
+            last_node->value_ = kv.second;
+            continue;
+        }
+        auto newnode = FindGreaterOrEqualFromFinger(kv.first, prenodes);
+        if (newnode != nullptr && Equal(newnode->key_, kv.first)) {
+            newnode->value_ = kv.second;
+            last_node = newnode;
+            continue;
+        }
+
+        int newheight = GetRandomHeight();
+        if (newheight > curr_height_) {     // 高于curr_height_的prenodes一直都是header_
+            curr_height_ = newheight;
+        }
+        newnode = NewNode(kv.first, kv.second, newheight);
+        for (int i = 0; i < newheight; ++i) {
+            newnode->SetNext(i, prenodes[i]->GetNext(i));
+            prenodes[i]->SetNext(i, newnode);
+            prenodes[i] = newnode;      // 下一个key更大,新结点就是它在这些层上的前驱
+        }
+        last_node = newnode;
+    }
+    return kvs.size();
+}
+
+template<class KEY, class VALUE, class COMPARATOR>
+template<class ITERATOR>
+bool SkipList<KEY, VALUE, COMPARATOR>::BulkLoad(ITERATOR first, ITERATOR last, bool deterministic) {
+    static_assert(std::is_base_of<std::forward_iterator_tag,
+                          typename std::iterator_traits<ITERATOR>::iterator_category>::value,
+                  "BulkLoad traverses the input twice, the iterator should be a forward iterator");
+    if (header_->GetNext(0) != nullptr) {
+        return false;
+    }
+    // 先检查一遍,不满足条件的输入不会留下构建了一半的跳表
+    for (auto prev = first, it = first; it != last; prev = it++) {
+        if (it != first && !Less(prev->first, it->first)) {
+            return false;
+        }
+    }
+    // tails[i]是第i层当前的最后一个结点,新结点总是直接接在它们后面
+    NodePtr tails[kMaxHeight];
+    for (int i = 0; i < kMaxHeight; ++i) {
+        tails[i] = header_;
+    }
+    size_t node_cnt = 0;
+    for (auto it = first; it != last; ++it) {
+        ++node_cnt;
+        int newheight = deterministic ? GetDeterministicHeight(node_cnt) : GetRandomHeight();
+        auto newnode = NewNode(it->first, it->second, newheight);
+        for (int i = 0; i < newheight; ++i) {
+            tails[i]->SetNext(i, newnode);
+            tails[i] = newnode;
+        }
+        if (newheight > curr_height_) {
+            curr_height_ = newheight;
+        }
+    }
+    return true;
+}
+
+template<class KEY, class VALUE, class COMPARATOR>
+bool SkipList<KEY, VALUE, COMPARATOR>::Delete(const KEY &key) {
+    if (index_ && index_->find(key) == index_->end()) {
+        return false;
+    }
     NodePtr prenodes[kMaxHeight] = {nullptr};
     auto findnode = FindGreaterOrEqual(key, prenodes);
     if (findnode == nullptr || !Equal(findnode->key_, key)) {
@@ -47,7 +131,10 @@ bool SkipList<KEY, VALUE>::Delete(const KEY &key) {
            prenodes[i]->SetNext(i, findnode->GetNext(i));
         }
     }
-    delete findnode;
+    if (index_) {
+        index_->erase(key);
+    }
+    FreeNode(findnode);
 
     while (curr_height_ > 1 && !header_->GetNext(curr_height_ - 1)) {
         --curr_height_;
@@ -55,8 +142,8 @@ bool SkipList<KEY, VALUE>::Delete(const KEY &key) {
     return true;
 }
 
-template<class KEY, class VALUE>
-void SkipList<KEY, VALUE>::Dump() {
+template<class KEY, class VALUE, class COMPARATOR>
+void SkipList<KEY, VALUE, COMPARATOR>::Dump() {
     // 首先打印header
     for (int i = 0; i < kMaxHeight; ++i) {
         std::cout << "header,";
@@ -73,8 +160,16 @@ void SkipList<KEY, VALUE>::Dump() {
     }
 }
 
-template<class KEY, class VALUE>
-bool SkipList<KEY, VALUE>::Get(const KEY &key, VALUE *value) const {
+template<class KEY, class VALUE, class COMPARATOR>
+bool SkipList<KEY, VALUE, COMPARATOR>::Get(const KEY &key, VALUE *value) const {
+    if (index_) {
+        auto findit = index_->find(key);
+        if (findit == index_->end()) {
+            return false;
+        }
+        *value = findit->second->value_;
+        return true;
+    }
     auto findnode = FindGreaterOrEqual(key, nullptr);
     if (findnode && Equal(findnode->key_, key)) {
         *value = findnode->value_;
@@ -83,16 +178,18 @@ bool SkipList<KEY, VALUE>::Get(const KEY &key, VALUE *value) const {
     return false;
 }
 
-template<class KEY, class VALUE>
-Node<KEY,VALUE>* SkipList<KEY, VALUE>::FindGreaterOrEqual(const KEY &key, NodePtr *prenodes) const {
+template<class KEY, class VALUE, class COMPARATOR>
+Node<KEY,VALUE>* SkipList<KEY, VALUE, COMPARATOR>::FindGreaterOrEqual(const KEY &key, NodePtr *prenodes) const {
     auto curr_node = header_;
     int curr_level = curr_height_ - 1;
+    NodePtr last_bigger = nullptr;      // 下降之后经常会再次遇到同一个结点,不需要重复比较
 
     while (true) {
         auto next_node = curr_node->GetNext(curr_level);
-        if (next_node && Less(next_node->key_, key)) {
+        if (next_node && next_node != last_bigger && Less(next_node->key_, key)) {
             curr_node = next_node;
         } else {        // 如果next是空的，或者大于等于key，就往下降一层，不过此时curr还是小于key的
+            last_bigger = next_node;
             if (prenodes) {
                 prenodes[curr_level] = curr_node;
             }
@@ -104,17 +201,53 @@ Node<KEY,VALUE>* SkipList<KEY, VALUE>::FindGreaterOrEqual(const KEY &key, NodePt
     }
 }
 
-template<class KEY, class VALUE>
-int SkipList<KEY, VALUE>::GetRandomHeight() {
+template<class KEY, class VALUE, class COMPARATOR>
+Node<KEY,VALUE>* SkipList<KEY, VALUE, COMPARATOR>::FindGreaterOrEqualFromFinger(const KEY &key, NodePtr *prenodes) const {
+    // 某一层的next大于等于key时,更高的层也一定满足,这些层的prenodes不需要改变
+    int valid_level = 0;
+    while (valid_level < curr_height_) {
+        auto next_node = prenodes[valid_level]->GetNext(valid_level);
+        if (next_node && Less(next_node->key_, key)) {
+            ++valid_level;
+        } else {
+            break;
+        }
+    }
+    // 从仍然有效的那一层的前驱出发向下查找,查找范围不会超过它在这一层上的下一个结点
+    auto curr_node = valid_level < curr_height_ ? prenodes[valid_level] : prenodes[curr_height_ - 1];
+    for (int curr_level = valid_level - 1; curr_level >= 0; --curr_level) {
+        while (true) {
+            auto next_node = curr_node->GetNext(curr_level);
+            if (next_node && Less(next_node->key_, key)) {
+                curr_node = next_node;
+            } else {
+                break;
+            }
+        }
+        prenodes[curr_level] = curr_node;
+    }
+    return prenodes[0]->GetNext(0);
+}
+
+template<class KEY, class VALUE, class COMPARATOR>
+int SkipList<KEY, VALUE, COMPARATOR>::GetRandomHeight() {
+    return height_gen_.NextHeight(kMaxHeight);
+}
+
+template<class KEY, class VALUE, class COMPARATOR>
+int SkipList<KEY, VALUE, COMPARATOR>::GetDeterministicHeight(size_t index) const {
+    // index从1开始,能被4^k整除的位置高度为k+1,和随机高度的期望分布相同
+    constexpr size_t branching = 1 << HeightGenerator::kBranchingBits;
     int height = 1;
-    while (height < kMaxHeight && random_.GetRandom() == 0) {
+    while (height < kMaxHeight && index % branching == 0) {
+        index /= branching;
         height++;
     }
     return height;
 }
 
-template<class KEY, class VALUE>
-Node<KEY,VALUE>* SkipList<KEY, VALUE>::FindLast() const {
+template<class KEY, class VALUE, class COMPARATOR>
+Node<KEY,VALUE>* SkipList<KEY, VALUE, COMPARATOR>::FindLast() const {
     // 从header的顶层出发,一直调用next并下降
     auto curr_node = header_;
     int curr_level = curr_height_ - 1;
@@ -132,8 +265,8 @@ Node<KEY,VALUE>* SkipList<KEY, VALUE>::FindLast() const {
     }
 }
 
-template<class KEY, class VALUE>
-Node<KEY, VALUE>* SkipList<KEY, VALUE>::FindLessThan(const KEY &key) const {
+template<class KEY, class VALUE, class COMPARATOR>
+Node<KEY, VALUE>* SkipList<KEY, VALUE, COMPARATOR>::FindLessThan(const KEY &key) const {
     auto curr_node = header_;       // 第一个header一般没有实际的key
     int curr_level = curr_height_ - 1;
 
@@ -150,5 +283,5 @@ Node<KEY, VALUE>* SkipList<KEY, VALUE>::FindLessThan(const KEY &key) const {
     }
 }
 
-
-
+// memtable中使用的跳表
+template class kvstore::SkipList<uint64_t, std::string>;
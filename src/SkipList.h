@@ -7,8 +7,15 @@
 
 #include <cassert>
 #include <iostream>
-#include <functional>
+#include <iterator>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
 #include <vector>
+#include "Arena.h"
+#include "Comparator.h"
 #include "Utils.h"
 #include "KvContainer.h"
 
@@ -18,73 +25,84 @@ namespace kvstore {
     struct Node {
         using NodePtr = Node*;
 
-        const KEY key_{0};
+        const KEY key_{};
 
-        VALUE value_{0};
+        VALUE value_{};
 
-        Node(const KEY &key, const VALUE &value, int level): key_(key), value_(value) {
-            nexts_.reserve(level);
+        Node(const KEY &key, const VALUE &value, int level): key_(key), value_(value), height_(level) {
+            for (int i = 0; i < height_; ++i) {
+                nexts_[i] = nullptr;
+            }
         }
 
-        explicit Node(int level) {
-            nexts_.reserve(level);
+        explicit Node(int level): height_(level) {
+            for (int i = 0; i < height_; ++i) {
+                nexts_[i] = nullptr;
+            }
         }
 
         ~Node() = default;
 
+        // 结点和它的next指针数组在同一块连续内存中,数组长度为level
+        static size_t AllocSize(int level) {
+            assert(level > 0);
+            return sizeof(Node) + sizeof(NodePtr) * (level - 1);
+        }
+
         NodePtr GetNext(int n) const {
-            assert(n >= 0);
+            assert(n >= 0 && n < height_);
             return nexts_[n];
         }
 
         void SetNext(int n, const NodePtr node) {
-            assert(n >= 0);
+            assert(n >= 0 && n < height_);
             nexts_[n] = node;
         }
 
-        void ResizeNext(int n) {
-            nexts_.resize(n, nullptr);
-        }
-
         int GetNextSize() const {
-            return nexts_.size();
+            return height_;
         }
 
     private:
-        std::vector<NodePtr> nexts_;
+        const int height_;
+        NodePtr nexts_[1];      // 实际长度为height_,紧跟在结点之后分配
     };
 
-    template<class KEY, class VALUE>
+    template<class KEY, class VALUE, class COMPARATOR>
     class SkipListIterator;
 
-    template<class KEY, class VALUE>
+    // COMPARATOR是三路比较的函数对象,默认直接比较KEY;需要运行时指定比较函数时使用FunctionComparator
+    template<class KEY, class VALUE, class COMPARATOR = DefaultComparator<KEY>>
     class SkipList: public KvContainer<KEY, VALUE> {
     public:
 
-        friend class SkipListIterator<KEY, VALUE>;
+        friend class SkipListIterator<KEY, VALUE, COMPARATOR>;
 
         using NodePtr = Node<KEY, VALUE>*;
 
-        using Comparator = std::function<int(const KEY&, const KEY&)>;
+        using Comparator = COMPARATOR;
+
+        using HashIndex = std::unordered_map<KEY, NodePtr>;
 
         enum CompareCode {
 
         };
 
-        explicit SkipList(Comparator comparator):
-                compare_(std::move(comparator)), random_(RandomMin, RandomMax) {
-                header_ = new Node<KEY, VALUE>(kMaxHeight);
-                header_->ResizeNext(kMaxHeight);
-                for (int i = 0; i < kMaxHeight; ++i) {
-                    header_->SetNext(i, nullptr);
-                }
+        // use_arena为true时,结点从arena中分配,被删除的结点只有在跳表析构时才释放内存
+        // use_hash_index为true时,额外维护key到结点的hash索引,Get只需要一次hash查找,
+        // 这要求KEY的operator==和comparator的相等判断一致
+        explicit SkipList(Comparator comparator = Comparator(), bool use_arena = false, bool use_hash_index = false):
+                compare_(std::move(comparator)),
+                arena_(use_arena ? new Arena() : nullptr),
+                index_(use_hash_index ? new HashIndex() : nullptr) {
+                header_ = NewNode(kMaxHeight);
         }
 
         ~SkipList() {     // 释放内存
             NodePtr curr_node = header_;
             while (curr_node) {
                 auto next_node = curr_node->GetNext(0);
-                delete curr_node;
+                FreeNode(curr_node);
                 curr_node = next_node;
             }
         }
@@ -95,6 +113,16 @@ namespace kvstore {
 
         bool Put(const KEY &key, const VALUE & value) override;
 
+        // 先按key对kvs原地排序(相同的key保留最后一个),再利用上一次插入的位置向后查找,依次插入
+        size_t PutBatch(std::vector<std::pair<KEY, VALUE>> &kvs);
+
+        // 在空跳表上用[first, last)中按key严格递增的kv一次性构建所有层,复杂度为O(n).
+        // 跳表非空或者输入没有排好序,有重复的key时不做任何修改并返回false.
+        // 先检查整个输入再构建,需要遍历两次,所以ITERATOR至少是前向迭代器,不支持istream_iterator这样的单遍输入迭代器.
+        // deterministic为true时按位置分配高度(每4个结点中有1个升高一层),否则随机分配
+        template<class ITERATOR>
+        bool BulkLoad(ITERATOR first, ITERATOR last, bool deterministic = false);
+
         bool Get(const KEY &key, VALUE *value) const override;
 
         bool Delete(const KEY &key) override;
@@ -109,49 +137,85 @@ namespace kvstore {
             return curr_height_;
         }
 
-    private:
+        bool UseArena() const {
+            return arena_ != nullptr;
+        }
 
-        static constexpr uint8_t kMaxHeight = 12;
+        bool UseHashIndex() const {
+            return index_ != nullptr;
+        }
 
-        static constexpr int RandomMin = 0;
+        void SeedHeight(uint64_t seed) {
+            height_gen_.Seed(seed);
+        }
+
+    private:
 
-        static constexpr int RandomMax = 3;
+        static constexpr uint8_t kMaxHeight = 12;
 
         bool Equal(const KEY &a, const KEY &b) const {
-            assert(compare_);
             return compare_(a, b) == 0;
         }
 
         bool Less(const KEY &a, const KEY &b) const {
-            assert(compare_);
             return compare_(a, b) < 0;
         }
 
         bool GreaterOrEqual(const KEY &a, const KEY &b) const {
-            assert(compare_);
             return compare_(a, b) >= 0;
         }
 
         int GetRandomHeight();
 
+        int GetDeterministicHeight(size_t index) const;
+
+        void *AllocateNode(int level) {
+            size_t size = Node<KEY, VALUE>::AllocSize(level);
+            return arena_ ? arena_->AllocateAligned(size) : ::operator new(size);
+        }
+
+        NodePtr NewNode(int level) {
+            return new (AllocateNode(level)) Node<KEY, VALUE>(level);
+        }
+
+        NodePtr NewNode(const KEY &key, const VALUE &value, int level) {
+            auto node = new (AllocateNode(level)) Node<KEY, VALUE>(key, value, level);
+            if (index_) {
+                index_->emplace(key, node);
+            }
+            return node;
+        }
+
+        void FreeNode(NodePtr node) {
+            node->~Node<KEY, VALUE>();
+            if (!arena_) {
+                ::operator delete(node);
+            }
+        }
+
         NodePtr FindGreaterOrEqual(const KEY& key, NodePtr *prenodes) const;
 
+        // prenodes是上一个(不大于key的)key的查找路径,从中找到仍然有效的最低一层,只在它下面重新查找
+        NodePtr FindGreaterOrEqualFromFinger(const KEY& key, NodePtr *prenodes) const;
+
         NodePtr FindLessThan(const KEY& key) const;
 
         NodePtr FindLast() const;
 
         NodePtr header_{nullptr};
         Comparator compare_;
-        Random random_;
+        HeightGenerator height_gen_;
+        std::unique_ptr<Arena> arena_;
+        std::unique_ptr<HashIndex> index_;
         int curr_height_{1};
     };
 
-    template<class KEY, class VALUE>
+    template<class KEY, class VALUE, class COMPARATOR = DefaultComparator<KEY>>
     class SkipListIterator {
     public:
         using ConstNodePtr = const Node<KEY, VALUE>*;
 
-        using ConstSkipList = const SkipList<KEY, VALUE>;
+        using ConstSkipList = const SkipList<KEY, VALUE, COMPARATOR>;
 
         explicit SkipListIterator(const ConstSkipList &skiplist): skip_list_(skiplist) {}
 
@@ -173,6 +237,56 @@ namespace kvstore {
             return next_node;
         }
 
+        // 以下的定位操作都会把迭代器停在返回的结点上,返回nullptr表示没有这样的结点
+        ConstNodePtr Seek(const KEY &key) {        // 第一个大于等于key的结点
+            curr_node_ = skip_list_.FindGreaterOrEqual(key, nullptr);
+            return curr_node_;
+        }
+
+        ConstNodePtr SeekToFirst() {
+            curr_node_ = skip_list_.header_->GetNext(0);
+            return curr_node_;
+        }
+
+        ConstNodePtr SeekToLast() {
+            auto last_node = skip_list_.FindLast();
+            curr_node_ = last_node == skip_list_.header_ ? nullptr : last_node;
+            return curr_node_;
+        }
+
+        // 结点中没有前向指针,所以需要从header重新查找,复杂度为O(log n)
+        ConstNodePtr Prev() {
+            assert(Valid());
+            auto prev_node = skip_list_.FindLessThan(curr_node_->key_);
+            curr_node_ = prev_node == skip_list_.header_ ? nullptr : prev_node;
+            return curr_node_;
+        }
+
+        bool Valid() const {
+            return curr_node_ != nullptr && curr_node_ != skip_list_.header_;
+        }
+
+        ConstNodePtr Curr() const {
+            return Valid() ? curr_node_ : nullptr;
+        }
+
+        // 依次对[begin, end)中的kv调用callback(key, value),callback返回false时提前结束
+        // 返回被访问的kv数量
+        template<class CALLBACK>
+        size_t Scan(const KEY &begin, const KEY &end, CALLBACK &&callback) {
+            size_t visit_cnt = 0;
+            auto curr_node = Seek(begin);
+            while (curr_node && skip_list_.Less(curr_node->key_, end)) {
+                curr_node_ = curr_node;
+                ++visit_cnt;
+                if (!callback(curr_node->key_, curr_node->value_)) {
+                    break;
+                }
+                curr_node = curr_node->GetNext(0);
+            }
+            return visit_cnt;
+        }
+
     private:
         ConstSkipList &skip_list_;
         ConstNodePtr curr_node_{nullptr};
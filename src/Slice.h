@@ -0,0 +1,39 @@
+//
+// Created by 杨丰硕 on 2023/3/21.
+//
+
+#ifndef KVSTORE_SLICE_H
+#define KVSTORE_SLICE_H
+
+#include <cstddef>
+#include <string>
+
+namespace kvstore {
+
+    // 指向一段外部内存的只读视图,不拥有这段内存
+    struct Slice {
+        const char *data_{nullptr};
+        size_t size_{0};
+
+        Slice() = default;
+
+        Slice(const char *data, size_t size): data_(data), size_(size) {}
+
+        explicit Slice(const std::string &str): data_(str.data()), size_(str.size()) {}
+
+        bool Empty() const {
+            return size_ == 0;
+        }
+
+        std::string ToString() const {
+            return std::string(data_, size_);
+        }
+
+        bool operator==(const Slice &slice) const {
+            return size_ == slice.size_ && std::char_traits<char>::compare(data_, slice.data_, size_) == 0;
+        }
+    };
+
+}
+
+#endif //KVSTORE_SLICE_H
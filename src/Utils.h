@@ -5,6 +5,9 @@
 #ifndef KVSTORE_UTILS_H
 #define KVSTORE_UTILS_H
 
+#include <atomic>
+#include <chrono>
+#include <cstdint>
 #include <random>
 #include <iostream>
 
@@ -23,6 +26,58 @@ namespace kvstore {
         std::default_random_engine engine_;
     };
 
+    // 生成跳表结点的高度: 一次splitmix64得到64位随机数,末尾每kBranchingBits个0升高一层,
+    // 即每一层升高的概率为1/4
+    class HeightGenerator {
+    public:
+        static constexpr int kBranchingBits = 2;
+
+        HeightGenerator(): state_(NextDefaultSeed()) {}
+
+        explicit HeightGenerator(uint64_t seed): state_(seed) {}
+
+        void Seed(uint64_t seed) {
+            state_ = seed;
+        }
+
+        uint64_t NextUint64() {
+            uint64_t z = (state_ += 0x9e3779b97f4a7c15ULL);
+            z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+            z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+            return z ^ (z >> 31);
+        }
+
+        int NextHeight(int max_height) {
+            uint64_t bits = NextUint64();
+            int height = bits == 0 ? max_height : 1 + __builtin_ctzll(bits) / kBranchingBits;
+            return height < max_height ? height : max_height;
+        }
+
+        // 每个线程各自一个生成器,并发的写者之间不需要同步
+        static HeightGenerator &ThreadLocal() {
+            static thread_local HeightGenerator generator;
+            return generator;
+        }
+
+        // 之后默认构造的生成器依次从seed派生,用于得到可以复现的测试结果
+        static void SetDefaultSeed(uint64_t seed) {
+            DefaultSeed().store(seed, std::memory_order_relaxed);
+        }
+
+    private:
+        static std::atomic<uint64_t> &DefaultSeed() {
+            static std::atomic<uint64_t> seed{static_cast<uint64_t>(
+                    std::chrono::steady_clock::now().time_since_epoch().count())};
+            return seed;
+        }
+
+        static uint64_t NextDefaultSeed() {
+            return DefaultSeed().fetch_add(0x9e3779b97f4a7c15ULL, std::memory_order_relaxed);
+        }
+
+        uint64_t state_;
+    };
+
 }
 
 #endif //KVSTORE_UTILS_H
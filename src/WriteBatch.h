@@ -0,0 +1,46 @@
+//
+// Created by 杨丰硕 on 2023/3/16.
+//
+
+#ifndef KVSTORE_WRITEBATCH_H
+#define KVSTORE_WRITEBATCH_H
+
+#include <string>
+#include <utility>
+#include <vector>
+#include "MemTable.h"
+
+namespace kvstore {
+
+    // 一组写入和删除,通过KvStore::Write一次性写入memtable,同一个key以最后一次操作为准
+    class WriteBatch {
+    public:
+        using Entry = std::pair<uint64_t, std::string>;
+
+        WriteBatch() = default;
+
+        void Put(uint64_t key, const std::string &value) {
+            entries_.emplace_back(key, EncodeValue(kTypeValue, value));
+        }
+
+        void Delete(uint64_t key) {
+            entries_.emplace_back(key, EncodeValue(kTypeDeletion, ""));
+        }
+
+        void Clear() {
+            entries_.clear();
+        }
+
+        size_t Count() const {
+            return entries_.size();
+        }
+
+    private:
+        friend class MemTable;
+
+        std::vector<Entry> entries_;        // value已经带上了类型
+    };
+
+}
+
+#endif //KVSTORE_WRITEBATCH_H
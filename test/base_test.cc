@@ -3,14 +3,22 @@
 //
 #include <iostream>
 #include <algorithm>
+#include <cmath>
 #include <vector>
 #include <memory>
 #include <unordered_map>
 #include <unordered_set>
+#include <set>
+#include <thread>
+#include <atomic>
 #include <gtest/gtest.h>
 #include "../src/Utils.h"
 #include "../src/SkipList.h"
 #include "../src/SkipList.cc"
+#include "../src/ConcurrentSkipList.h"
+#include "../src/ConcurrentSkipList.cc"
+#include "../src/ShardedSkipList.h"
+#include "../src/ShardedSkipList.cc"
 #include "test_utils.h"
 
 using namespace kvstore;
@@ -148,8 +156,49 @@ TEST(SKLIST_TEST, BASE_RANDOM_TEST) {
 
 }
 
+TEST(SKLIST_TEST, HEIGHT_GENERATOR_TEST) {
+    const int max_height = 12;
+    const int draw_cnt = 1000000;
+    // 相同的种子得到相同的高度序列
+    HeightGenerator gen1(42), gen2(42);
+    for (int i = 0; i < 1000; ++i) {
+        ASSERT_EQ(gen1.NextHeight(max_height), gen2.NextHeight(max_height));
+    }
+
+    std::vector<int> height_cnt(max_height + 1, 0);
+    double random_cost, generator_cost;
+    int64_t height_sum = 0;
+    {
+        Random random(0, 3);
+        testutils::TimeCounter random_counter(random_cost);
+        for (int i = 0; i < draw_cnt; ++i) {
+            int height = 1;
+            while (height < max_height && random.GetRandom() == 0) {
+                height++;
+            }
+            height_sum += height;
+        }
+    }
+    printf("The Random height cost is %lf\n", random_cost);
+    {
+        testutils::TimeCounter generator_counter(generator_cost);
+        for (int i = 0; i < draw_cnt; ++i) {
+            int height = gen1.NextHeight(max_height);
+            height_cnt[height]++;
+            height_sum += height;
+        }
+    }
+    printf("The HeightGenerator height cost is %lf\n", generator_cost);
+    // 每一层的结点数大约是下一层的1/4
+    for (int height = 1; height <= 4; ++height) {
+        double expect = draw_cnt * 0.75 * std::pow(0.25, height - 1);
+        ASSERT_NEAR(height_cnt[height], expect, expect * 0.05);
+    }
+    ASSERT_GT(height_sum, 0);
+}
+
 TEST(SKLIST_TEST, SIMPLE_TEST) {
-    auto sklist = std::make_unique<SkipList<int, int>>(CompareInt);
+    auto sklist = std::make_unique<SkipList<int, int, FunctionComparator<int>>>(CompareInt);
     sklist->Put(1, 1);
     sklist->Put(2, 2);
     sklist->Put(4, 1);
@@ -160,7 +209,7 @@ TEST(SKLIST_TEST, MUTI_TEST) {
     const int max_range = 130;
     Random random_gene(0, max_range);
     // auto sklist = std::make_unique<SkipList<std::string, std::string>>();
-    auto sklist = std::make_unique<SkipList<std::string , std::string>>(CompareString);
+    auto sklist = std::make_unique<SkipList<std::string, std::string, FunctionComparator<std::string>>>(CompareString);
     // insert numbers
     std::vector<int> numbers;
     std::unordered_set<int> number_set;
@@ -197,7 +246,7 @@ TEST(SKLIST_TEST, DELETE_TEST) {
     const int max_range = 500;
     Random random_gene(0, max_range);
 
-    auto sklist = std::make_unique<SkipList<int, int>>(CompareInt);
+    auto sklist = std::make_unique<SkipList<int, int, FunctionComparator<int>>>(CompareInt);
     std::vector<int> numbers;
     std::unordered_set<int> number_set;
     std::unordered_set<int> delete_set;
@@ -241,7 +290,7 @@ TEST(SKLIST_TEST, COMPARE_WITH_OTHERS) {
     std::unordered_set<int> test_set;
     std::vector<IntKv> sorted_vac;
     Random random_gene(0, max_size * 2);
-    SkipList<int, int> sklist(CompareInt);
+    SkipList<int, int> sklist;
     STLMapKv<int, int> stlmap;
     // 构造数据源
     while (lookup_set.size() != max_size) {
@@ -305,8 +354,8 @@ TEST(SKLIST_TEST, ITERATOR_TEST) {
     const int max_range = 5000;
     const int max_count = 5000;
     Random random_gene(0, max_range);
-    // auto sklist = std::make_unique<SkipList<int, int>>(CompareInt);
-    SkipList<int, int> sklist(CompareInt);
+    // auto sklist = std::make_unique<SkipList<int, int, FunctionComparator<int>>>(CompareInt);
+    SkipList<int, int> sklist;
     SkipListIterator<int, int> sklistIt(sklist);
     // 插入数值
     std::unordered_set<int> insert_keys;
@@ -334,6 +383,533 @@ TEST(SKLIST_TEST, ITERATOR_TEST) {
     ASSERT_EQ(it_node_cnt, max_count);
 }
 
+TEST(SKLIST_TEST, SEEK_SCAN_TEST) {
+    SkipList<int, int> sklist;
+    SkipListIterator<int, int> sklistIt(sklist);
+    ASSERT_EQ(sklistIt.SeekToFirst(), nullptr);
+    ASSERT_EQ(sklistIt.SeekToLast(), nullptr);
+    ASSERT_EQ(sklistIt.Seek(0), nullptr);
+    // 插入0,10,20...990
+    for (int i = 0; i < 100; ++i) {
+        sklist.Put(i * 10, i);
+    }
+    ASSERT_EQ(sklistIt.SeekToFirst()->key_, 0);
+    ASSERT_EQ(sklistIt.SeekToLast()->key_, 990);
+    ASSERT_EQ(sklistIt.Seek(-5)->key_, 0);
+    ASSERT_EQ(sklistIt.Seek(500)->key_, 500);
+    ASSERT_EQ(sklistIt.Seek(501)->key_, 510);
+    ASSERT_EQ(sklistIt.Next()->key_, 520);
+    ASSERT_EQ(sklistIt.Seek(991), nullptr);
+    ASSERT_FALSE(sklistIt.Valid());
+    // 从尾部反向遍历
+    int expect_key = 990;
+    for (auto curr_node = sklistIt.SeekToLast(); curr_node; curr_node = sklistIt.Prev()) {
+        ASSERT_EQ(curr_node->key_, expect_key);
+        expect_key -= 10;
+    }
+    ASSERT_EQ(expect_key, -10);
+    // 范围扫描
+    std::vector<int> scan_keys;
+    auto scan_cnt = sklistIt.Scan(95, 150, [&scan_keys](const int &key, const int &value) {
+        scan_keys.push_back(key);
+        return true;
+    });
+    ASSERT_EQ(scan_cnt, 5);
+    ASSERT_EQ(scan_keys, std::vector<int>({100, 110, 120, 130, 140}));
+    scan_cnt = sklistIt.Scan(0, 1000, [](const int &key, const int &value) {
+        return key < 300;
+    });
+    ASSERT_EQ(scan_cnt, 31);
+    ASSERT_EQ(sklistIt.Curr()->key_, 300);
+    ASSERT_EQ(sklistIt.Scan(150, 150, [](const int &key, const int &value) { return true; }), 0);
+}
+
+TEST(SKLIST_TEST, ARENA_TEST) {
+    Arena arena;
+    std::vector<std::pair<char*, size_t>> allocated;
+    size_t total_bytes = 0;
+    for (size_t i = 1; i < 2000; ++i) {
+        size_t bytes = (i % 97 == 0) ? 100000 : i % 300 + 1;
+        char *mem = (i % 2) ? arena.AllocateAligned(bytes) : arena.Allocate(bytes);
+        if (i % 2) {
+            ASSERT_EQ(reinterpret_cast<uintptr_t>(mem) & (alignof(std::max_align_t) - 1), 0);
+        }
+        memset(mem, static_cast<int>(i % 256), bytes);
+        allocated.emplace_back(mem, bytes);
+        total_bytes += bytes;
+    }
+    ASSERT_GE(arena.MemoryUsage(), total_bytes);
+    for (size_t i = 0; i < allocated.size(); ++i) {     // 检查各块内存之间没有互相覆盖
+        auto &mem = allocated[i];
+        for (size_t b = 0; b < mem.second; ++b) {
+            ASSERT_EQ(static_cast<unsigned char>(mem.first[b]), (i + 1) % 256);
+        }
+    }
+}
+
+TEST(SKLIST_TEST, ARENA_SKLIST_TEST) {
+    const int max_size = 100000;
+    Random random_gene(0, max_size * 4);
+    std::vector<int> numbers;
+    std::unordered_set<int> number_set;
+    while (number_set.size() != max_size) {
+        auto number = random_gene.GetRandom();
+        if (number_set.insert(number).second) {
+            numbers.push_back(number);
+        }
+    }
+
+    double heap_cost, arena_cost;
+    SkipList<int, int> heap_sklist;
+    SkipList<int, int> arena_sklist(DefaultComparator<int>(), true);
+    ASSERT_FALSE(heap_sklist.UseArena());
+    ASSERT_TRUE(arena_sklist.UseArena());
+    {
+        testutils::TimeCounter heap_counter(heap_cost);
+        for (auto number : numbers) {
+            heap_sklist.Put(number, number);
+        }
+    }
+    printf("The heap skip list put cost is %lf\n", heap_cost);
+    {
+        testutils::TimeCounter arena_counter(arena_cost);
+        for (auto number : numbers) {
+            arena_sklist.Put(number, number);
+        }
+    }
+    printf("The arena skip list put cost is %lf\n", arena_cost);
+
+    int get_val;
+    for (size_t i = 0; i < numbers.size(); ++i) {
+        if (i % 2) {
+            ASSERT_TRUE(arena_sklist.Delete(numbers[i]));
+        }
+    }
+    for (size_t i = 0; i < numbers.size(); ++i) {
+        ASSERT_EQ(arena_sklist.Get(numbers[i], &get_val), i % 2 == 0);
+        if (i % 2 == 0) {
+            ASSERT_EQ(get_val, numbers[i]);
+        }
+    }
+}
+
+TEST(SKLIST_TEST, CONCURRENT_TEST) {
+    const int writer_cnt = 4;
+    const int key_per_writer = 20000;
+    ConcurrentSkipList<int, int> sklist;
+    std::atomic<bool> writing{true};
+    std::atomic<int> read_errors{0};
+
+    std::vector<std::thread> writers;
+    for (int w = 0; w < writer_cnt; ++w) {
+        writers.emplace_back([&sklist, w]() {
+            // 各写者交错写入,并且有一部分key是重叠的
+            for (int i = 0; i < key_per_writer; ++i) {
+                int key = i * writer_cnt + w;
+                sklist.Put(key, key);
+                sklist.Put(i, i);
+            }
+        });
+    }
+    std::thread reader([&]() {
+        while (writing.load()) {
+            int get_val;
+            for (int key = 0; key < key_per_writer; key += 97) {
+                if (sklist.Get(key, &get_val) && get_val != key) {
+                    read_errors++;
+                }
+            }
+        }
+    });
+    for (auto &writer : writers) {
+        writer.join();
+    }
+    writing.store(false);
+    reader.join();
+    ASSERT_EQ(read_errors.load(), 0);
+
+    int get_val;
+    for (int key = 0; key < key_per_writer * writer_cnt; ++key) {
+        ASSERT_TRUE(sklist.Get(key, &get_val));
+        ASSERT_EQ(get_val, key);
+    }
+    for (int key = 0; key < key_per_writer * writer_cnt; key += 2) {
+        ASSERT_TRUE(sklist.Delete(key));
+    }
+    ASSERT_FALSE(sklist.Delete(0));
+    // 迭代器应该按序只返回未被删除的key
+    ConcurrentSkipListIterator<int, int> sklistIt(sklist);
+    sklistIt.Init();
+    int expect_key = 1;
+    while (sklistIt.HasNext()) {
+        auto curr_node = sklistIt.Next();
+        ASSERT_EQ(curr_node->key_, expect_key);
+        ASSERT_EQ(*curr_node->GetValue(), expect_key);
+        expect_key += 2;
+    }
+    ASSERT_EQ(expect_key, key_per_writer * writer_cnt + 1);
+}
+
+TEST(SKLIST_TEST, CONCURRENT_MEMORY_TEST) {
+    ConcurrentSkipList<int, std::string> sklist;
+    ASSERT_EQ(sklist.MemoryUsage(), 0);
+    for (int key = 0; key < 100; ++key) {
+        ASSERT_TRUE(sklist.Put(key, std::string(100, 'a')));
+    }
+    size_t usage = sklist.MemoryUsage();
+    ASSERT_GT(usage, 100 * 100);
+    ASSERT_EQ(sklist.GarbageUsage(), 0);
+    // 覆盖写不释放旧的value,内存和垃圾一起增长
+    for (int round = 0; round < 10; ++round) {
+        ASSERT_TRUE(sklist.Put(0, std::string(100, 'b')));
+    }
+    ASSERT_GT(sklist.MemoryUsage(), usage + 10 * 100);
+    ASSERT_EQ(sklist.MemoryUsage() - usage, sklist.GarbageUsage());
+    // 被删除的结点也是垃圾,再次写入同一个key时复用
+    size_t garbage = sklist.GarbageUsage();
+    usage = sklist.MemoryUsage();
+    ASSERT_TRUE(sklist.Delete(1));
+    ASSERT_EQ(sklist.MemoryUsage(), usage);
+    size_t deleted_garbage = sklist.GarbageUsage();
+    ASSERT_GT(deleted_garbage, garbage + 100);
+    ASSERT_TRUE(sklist.Put(1, "c"));
+    ASSERT_LT(sklist.GarbageUsage(), deleted_garbage);     // 只剩下被删除的value
+    ASSERT_GT(sklist.GarbageUsage(), garbage + 100);
+    std::string value;
+    ASSERT_TRUE(sklist.Get(1, &value));
+    ASSERT_EQ(value, "c");
+}
+
+// 编译期的比较器策略,按key递减排序
+struct ReverseComparator {
+    int operator()(const uint64_t &a, const uint64_t &b) const {
+        return a > b ? -1 : (a == b ? 0 : 1);
+    }
+};
+
+TEST(SKLIST_TEST, COMPARATOR_TEST) {
+    const int max_size = 5000;
+    Random random_gene(0, max_size * 8);
+    std::set<uint64_t> expect;
+    SkipList<uint64_t, std::string> inline_sklist;
+    SkipList<uint64_t, std::string, FunctionComparator<uint64_t>> func_sklist(
+            [](const uint64_t &a, const uint64_t &b) -> int {
+                return a < b ? -1 : (a == b ? 0 : 1);
+            });
+    SkipList<uint64_t, std::string, ReverseComparator> reverse_sklist;
+    for (int i = 0; i < max_size; ++i) {
+        uint64_t key = random_gene.GetRandom();
+        expect.insert(key);
+        inline_sklist.Put(key, std::to_string(key));
+        func_sklist.Put(key, std::to_string(key));
+        reverse_sklist.Put(key, std::to_string(key));
+    }
+    // 内联的比较器和std::function的比较器得到相同的顺序,自定义的比较器决定遍历的方向
+    SkipListIterator<uint64_t, std::string> inline_it(inline_sklist);
+    SkipListIterator<uint64_t, std::string, FunctionComparator<uint64_t>> func_it(func_sklist);
+    SkipListIterator<uint64_t, std::string, ReverseComparator> reverse_it(reverse_sklist);
+    inline_it.Init();
+    func_it.Init();
+    reverse_it.Init();
+    auto expect_it = expect.begin();
+    auto expect_rit = expect.rbegin();
+    for (; expect_it != expect.end(); ++expect_it, ++expect_rit) {
+        ASSERT_TRUE(inline_it.HasNext());
+        ASSERT_TRUE(func_it.HasNext());
+        ASSERT_TRUE(reverse_it.HasNext());
+        ASSERT_EQ(inline_it.Next()->key_, *expect_it);
+        ASSERT_EQ(func_it.Next()->key_, *expect_it);
+        ASSERT_EQ(reverse_it.Next()->key_, *expect_rit);
+    }
+    ASSERT_FALSE(inline_it.HasNext());
+    ASSERT_FALSE(func_it.HasNext());
+    ASSERT_FALSE(reverse_it.HasNext());
+    std::string get_val;
+    for (uint64_t key = 0; key < max_size * 8; key += 7) {
+        ASSERT_EQ(reverse_sklist.Get(key, &get_val), expect.count(key) > 0);
+    }
+}
+
+// 跳表很小,整个放在cache中,查找的耗时主要来自比较;只输出耗时和比值,不断言快慢
+TEST(SKLIST_TEST, COMPARATOR_BENCH) {
+    const int max_size = 1024;
+    const int lookup_rounds = 200;
+    std::vector<uint64_t> keys;
+    Random random_gene(0, max_size * 8);
+    SkipList<uint64_t, std::string> inline_sklist;
+    SkipList<uint64_t, std::string, FunctionComparator<uint64_t>> func_sklist(
+            [](const uint64_t &a, const uint64_t &b) -> int {
+                return a < b ? -1 : (a == b ? 0 : 1);
+            });
+    for (int i = 0; i < max_size; ++i) {
+        uint64_t key = random_gene.GetRandom();
+        keys.push_back(key);
+        inline_sklist.Put(key, "");
+        func_sklist.Put(key, "");
+    }
+    std::shuffle(keys.begin(), keys.end(), std::default_random_engine(0));
+
+    std::string get_val;
+    size_t found_cnt = 0;
+    auto lookup = [&](const auto &sklist) {
+        for (int r = 0; r < lookup_rounds; ++r) {
+            for (auto key: keys) {
+                found_cnt += sklist.Get(key, &get_val);
+            }
+        }
+    };
+    lookup(func_sklist);        // 预热
+    lookup(inline_sklist);
+    // 交替测量几轮取最小值,减少其他负载的干扰
+    double inline_cost = 1e9, func_cost = 1e9;
+    for (int round = 0; round < 5; ++round) {
+        double cost;
+        {
+            testutils::TimeCounter func_counter(cost);
+            lookup(func_sklist);
+        }
+        func_cost = std::min(func_cost, cost);
+        {
+            testutils::TimeCounter inline_counter(cost);
+            lookup(inline_sklist);
+        }
+        inline_cost = std::min(inline_cost, cost);
+    }
+    printf("The std::function comparator get cost is %lf, the inline comparator get cost is %lf, ratio %.2lf\n",
+           func_cost, inline_cost, func_cost / inline_cost);
+    ASSERT_EQ(found_cnt, keys.size() * lookup_rounds * 12);
+}
+
+TEST(SKLIST_TEST, BATCH_PUT_TEST) {
+    const int batch_cnt = 50;
+    const int batch_size = 4000;
+    using IntKv = std::pair<int, int>;
+    // 每个batch中的key聚集在一个随机的区间内,并且有少量重复
+    std::vector<std::vector<IntKv>> batches;
+    std::unordered_map<int, int> expect_kvs;
+    Random random_gene(0, batch_cnt * batch_size * 4);
+    Random offset_gene(0, batch_size * 2);
+    for (int b = 0; b < batch_cnt; ++b) {
+        std::vector<IntKv> batch;
+        int base = random_gene.GetRandom();
+        for (int i = 0; i < batch_size; ++i) {
+            int key = base + offset_gene.GetRandom();
+            batch.emplace_back(key, b * batch_size + i);
+            expect_kvs[key] = b * batch_size + i;
+        }
+        batches.push_back(batch);
+    }
+
+    SkipList<int, int> single_sklist;
+    SkipList<int, int> batch_sklist;
+    double single_cost, batch_cost;
+    {
+        testutils::TimeCounter single_counter(single_cost);
+        for (auto &batch : batches) {
+            for (auto &kv : batch) {
+                single_sklist.Put(kv.first, kv.second);
+            }
+        }
+    }
+    printf("The single put cost is %lf\n", single_cost);
+    {
+        testutils::TimeCounter batch_counter(batch_cost);
+        for (auto &batch : batches) {
+            batch_sklist.PutBatch(batch);
+        }
+    }
+    printf("The batch put cost is %lf\n", batch_cost);
+
+    int get_val;
+    for (auto &kv : expect_kvs) {
+        ASSERT_TRUE(batch_sklist.Get(kv.first, &get_val));
+        ASSERT_EQ(get_val, kv.second);
+    }
+    SkipListIterator<int, int> sklistIt(batch_sklist);
+    size_t it_node_cnt = 0;
+    int pre_key = -1;
+    for (auto curr_node = sklistIt.SeekToFirst(); curr_node; curr_node = sklistIt.Next()) {
+        ASSERT_LT(pre_key, curr_node->key_);
+        pre_key = curr_node->key_;
+        it_node_cnt++;
+    }
+    ASSERT_EQ(it_node_cnt, expect_kvs.size());
+}
+
+TEST(SKLIST_TEST, BULK_LOAD_TEST) {
+    const int max_size = 200000;
+    std::vector<std::pair<int, int>> sorted_kvs;
+    for (int i = 0; i < max_size; ++i) {
+        sorted_kvs.emplace_back(i * 3, i);
+    }
+    sorted_kvs.emplace_back(max_size * 3, max_size);
+
+    double put_cost, random_cost, deterministic_cost;
+    SkipList<int, int> put_sklist;
+    SkipList<int, int> random_sklist;
+    SkipList<int, int> deterministic_sklist;
+    {
+        testutils::TimeCounter put_counter(put_cost);
+        for (auto &kv : sorted_kvs) {
+            put_sklist.Put(kv.first, kv.second);
+        }
+    }
+    printf("The put cost is %lf\n", put_cost);
+    {
+        testutils::TimeCounter random_counter(random_cost);
+        ASSERT_TRUE(random_sklist.BulkLoad(sorted_kvs.begin(), sorted_kvs.end()));
+    }
+    printf("The random height bulk load cost is %lf\n", random_cost);
+    {
+        testutils::TimeCounter deterministic_counter(deterministic_cost);
+        ASSERT_TRUE(deterministic_sklist.BulkLoad(sorted_kvs.begin(), sorted_kvs.end(), true));
+    }
+    printf("The deterministic height bulk load cost is %lf\n", deterministic_cost);
+    printf("The height of random and deterministic is %d, %d\n",
+           random_sklist.GetCurrHeight(), deterministic_sklist.GetCurrHeight());
+
+    int get_val;
+    for (int i = 0; i <= max_size; ++i) {
+        ASSERT_TRUE(random_sklist.Get(i * 3, &get_val));
+        ASSERT_EQ(get_val, i);
+        ASSERT_TRUE(deterministic_sklist.Get(i * 3, &get_val));
+        ASSERT_EQ(get_val, i);
+        ASSERT_FALSE(deterministic_sklist.Get(i * 3 + 1, &get_val));
+    }
+    // 构建完成之后仍然可以正常写入和删除
+    ASSERT_TRUE(deterministic_sklist.Put(4, 4));
+    ASSERT_TRUE(deterministic_sklist.Delete(3));
+    SkipListIterator<int, int> sklistIt(deterministic_sklist);
+    ASSERT_EQ(sklistIt.SeekToFirst()->key_, 0);
+    ASSERT_EQ(sklistIt.Next()->key_, 4);
+    ASSERT_EQ(sklistIt.Next()->key_, 6);
+    ASSERT_EQ(sklistIt.SeekToLast()->key_, max_size * 3);
+
+    // 非空的跳表,没有排好序或者有重复key的输入都被拒绝,跳表保持不变
+    ASSERT_FALSE(deterministic_sklist.BulkLoad(sorted_kvs.begin(), sorted_kvs.end()));
+    ASSERT_TRUE(deterministic_sklist.Get(4, &get_val));
+    std::vector<std::pair<int, int>> unsorted_kvs = {{1, 1}, {5, 5}, {3, 3}};
+    std::vector<std::pair<int, int>> duplicate_kvs = {{1, 1}, {3, 3}, {3, 4}};
+    for (auto *kvs : {&unsorted_kvs, &duplicate_kvs}) {
+        SkipList<int, int> invalid_sklist;
+        ASSERT_FALSE(invalid_sklist.BulkLoad(kvs->begin(), kvs->end()));
+        SkipListIterator<int, int> invalid_it(invalid_sklist);
+        ASSERT_EQ(invalid_it.SeekToFirst(), nullptr);
+        ASSERT_TRUE(invalid_sklist.Put(2, 2));
+        ASSERT_TRUE(invalid_sklist.Get(2, &get_val));
+    }
+    std::vector<std::pair<int, int>> empty_kvs;
+    SkipList<int, int> empty_sklist;
+    ASSERT_TRUE(empty_sklist.BulkLoad(empty_kvs.begin(), empty_kvs.end()));
+}
+
+TEST(SKLIST_TEST, SHARDED_TEST) {
+    const int writer_cnt = 4;
+    const int key_per_writer = 20000;
+    const int max_key = writer_cnt * key_per_writer;
+    ShardedSkipList<int, int> hash_sklist(8);
+    ShardedSkipList<int, int> range_sklist(std::vector<int>({max_key / 4, max_key / 2, max_key / 4 * 3}));
+    ASSERT_EQ(hash_sklist.GetShardCount(), 8);
+    ASSERT_EQ(range_sklist.GetShardCount(), 4);
+
+    double put_cost;
+    {
+        testutils::TimeCounter put_counter(put_cost);
+        std::vector<std::thread> writers;
+        for (int w = 0; w < writer_cnt; ++w) {
+            writers.emplace_back([&, w]() {
+                for (int i = 0; i < key_per_writer; ++i) {
+                    int key = i * writer_cnt + w;
+                    hash_sklist.Put(key, key);
+                    range_sklist.Put(key, key);
+                }
+            });
+        }
+        for (auto &writer: writers) {
+            writer.join();
+        }
+    }
+    printf("The sharded put cost is %lf\n", put_cost);
+
+    int get_val;
+    for (int key = 0; key < max_key; ++key) {
+        ASSERT_TRUE(hash_sklist.Get(key, &get_val));
+        ASSERT_EQ(get_val, key);
+        ASSERT_TRUE(range_sklist.Get(key, &get_val));
+        if (key % 3 == 0) {
+            ASSERT_TRUE(hash_sklist.Delete(key));
+            ASSERT_TRUE(range_sklist.Delete(key));
+        }
+    }
+    // 合并之后的迭代顺序是全局有序的
+    for (auto sklist : {&hash_sklist, &range_sklist}) {
+        ShardedSkipListIterator<int, int> sklistIt(*sklist);
+        int expect_key = 1;
+        for (auto curr_node = sklistIt.SeekToFirst(); curr_node; curr_node = sklistIt.Next()) {
+            ASSERT_EQ(curr_node->key_, expect_key);
+            expect_key += (expect_key % 3 == 1) ? 1 : 2;
+        }
+        ASSERT_GE(expect_key, max_key);
+        ASSERT_EQ(sklistIt.Seek(30000)->key_, 30001);     // 30000已经被删除
+        ASSERT_EQ(sklistIt.Next()->key_, 30002);
+        ASSERT_EQ(sklistIt.Seek(max_key), nullptr);
+        ASSERT_FALSE(sklistIt.Valid());
+    }
+}
+
+TEST(SKLIST_TEST, HASH_INDEX_TEST) {
+    const int max_size = 200000;
+    std::vector<uint64_t> keys;
+    Random random_gene(0, max_size * 8);
+    SkipList<uint64_t, std::string> sklist;
+    SkipList<uint64_t, std::string> index_sklist(DefaultComparator<uint64_t>(), true, true);
+    ASSERT_TRUE(index_sklist.UseHashIndex());
+    for (int i = 0; i < max_size; ++i) {
+        uint64_t key = random_gene.GetRandom();
+        keys.push_back(key);
+        sklist.Put(key, std::to_string(key));
+        index_sklist.Put(key, std::to_string(key));
+    }
+    std::shuffle(keys.begin(), keys.end(), std::default_random_engine(0));
+
+    double sklist_cost, index_cost;
+    std::string get_val;
+    {
+        testutils::TimeCounter sklist_counter(sklist_cost);
+        for (auto key : keys) {
+            ASSERT_TRUE(sklist.Get(key, &get_val));
+        }
+    }
+    printf("The skip list get cost is %lf\n", sklist_cost);
+    {
+        testutils::TimeCounter index_counter(index_cost);
+        for (auto key : keys) {
+            ASSERT_TRUE(index_sklist.Get(key, &get_val));
+        }
+    }
+    printf("The hash index get cost is %lf\n", index_cost);
+
+    // 覆盖写,删除和批量写入都要同步更新索引
+    ASSERT_TRUE(index_sklist.Put(keys[0], "updated"));
+    ASSERT_TRUE(index_sklist.Get(keys[0], &get_val));
+    ASSERT_EQ(get_val, "updated");
+    ASSERT_TRUE(index_sklist.Delete(keys[1]));
+    ASSERT_FALSE(index_sklist.Get(keys[1], &get_val));
+    ASSERT_FALSE(index_sklist.Delete(keys[1]));
+    std::vector<std::pair<uint64_t, std::string>> batch = {{keys[1], "batch"}, {max_size * 8 + 1, "new"}};
+    index_sklist.PutBatch(batch);
+    ASSERT_TRUE(index_sklist.Get(keys[1], &get_val));
+    ASSERT_EQ(get_val, "batch");
+    ASSERT_TRUE(index_sklist.Get(max_size * 8 + 1, &get_val));
+    ASSERT_EQ(get_val, "new");
+
+    SkipList<int, int> bulk_sklist(DefaultComparator<int>(), false, true);
+    std::vector<std::pair<int, int>> sorted_kvs = {{1, 1}, {2, 2}, {3, 3}};
+    ASSERT_TRUE(bulk_sklist.BulkLoad(sorted_kvs.begin(), sorted_kvs.end()));
+    int int_val;
+    ASSERT_TRUE(bulk_sklist.Get(2, &int_val));
+    ASSERT_EQ(int_val, 2);
+}
 
 int main(int argc, char* argv[]) {
     testing::InitGoogleTest(&argc, argv);
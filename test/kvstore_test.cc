@@ -0,0 +1,551 @@
+//
+// Created by 杨丰硕 on 2023/3/15.
+//
+#include <dirent.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <map>
+#include <random>
+#include <string>
+#include <unordered_map>
+#include <gtest/gtest.h>
+#include "../src/KvStore.h"
+#include "test_utils.h"
+
+using namespace kvstore;
+
+static Options TestOptions(const std::string &dir) {
+    Options options;
+    options.dir_ = dir;
+    options.memtable_size_ = 64 * 1024;
+    return options;
+}
+
+static std::string TestValue(uint64_t key) {
+    return "value_" + std::to_string(key) + std::string(key % 64, 'v');
+}
+
+// 返回dir中SSTable文件的数量,remove为true时同时删除它们和manifest,之后打开的是一个空的KvStore
+static size_t CountTableFiles(const std::string &dir, bool remove = false) {
+    size_t count = 0;
+    if (remove) {
+        unlink((dir + "/MANIFEST").c_str());
+    }
+    DIR *dirp = opendir(dir.c_str());
+    if (!dirp) {
+        return 0;
+    }
+    while (dirent *entry = readdir(dirp)) {
+        std::string name = entry->d_name;
+        if (name.size() > 4 && name.compare(name.size() - 4, 4, ".sst") == 0) {
+            ++count;
+            if (remove) {
+                unlink((dir + "/" + name).c_str());
+            }
+        }
+    }
+    closedir(dirp);
+    return count;
+}
+
+TEST(MEMTABLE_TEST, BASIC_TEST) {
+    MemTable memtable;
+    std::string value;
+    bool deleted;
+    ASSERT_EQ(memtable.ApproximateMemoryUsage(), 0);
+    ASSERT_FALSE(memtable.Get(1, &value, &deleted));
+
+    memtable.Put(1, "one");
+    memtable.Put(2, "two");
+    memtable.Delete(2);
+    ASSERT_GT(memtable.ApproximateMemoryUsage(), 0);
+    ASSERT_TRUE(memtable.Get(1, &value, &deleted));
+    ASSERT_FALSE(deleted);
+    ASSERT_EQ(value, "one");
+    ASSERT_TRUE(memtable.Get(2, &value, &deleted));     // 墓碑也是一条记录
+    ASSERT_TRUE(deleted);
+
+    memtable.Freeze();
+    ASSERT_TRUE(memtable.IsFrozen());
+
+    MemTable plain_memtable(true, false), index_memtable(true, true);
+    for (auto table : {&plain_memtable, &index_memtable}) {
+        table->Put(1, "one");
+        table->Delete(1);
+        ASSERT_TRUE(table->Get(1, &value, &deleted));
+        ASSERT_TRUE(deleted);
+    }
+    ASSERT_GT(index_memtable.ApproximateMemoryUsage(), plain_memtable.ApproximateMemoryUsage());
+}
+
+TEST(ITERATOR_TEST, MERGING_TEST) {
+    std::vector<std::pair<uint64_t, std::string>> newer{{1, "a1"}, {3, "a3"}, {5, "a5"}};
+    std::vector<std::pair<uint64_t, std::string>> older{{1, "b1"}, {2, "b2"}, {5, "b5"}, {9, "b9"}};
+    MemTable memtable;
+    memtable.Put(2, "c2");
+    memtable.Put(10, "c10");
+    std::vector<std::unique_ptr<Iterator>> children;
+    children.push_back(NewVectorIterator(newer));
+    children.push_back(NewVectorIterator(older));
+    children.push_back(memtable.NewIterator());
+    children.push_back(NewVectorIterator({}));
+    auto iter = NewMergingIterator(std::move(children));
+    std::vector<std::pair<uint64_t, std::string>> result;
+    for (iter->SeekToFirst(); iter->Valid(); iter->Next()) {
+        result.emplace_back(iter->Key(), iter->Value().ToString());
+    }
+    // 同一个key只保留最新的child中的记录,memtable中的value带有类型
+    std::vector<std::pair<uint64_t, std::string>> expect{
+            {1, "a1"}, {2, "b2"}, {3, "a3"}, {5, "a5"}, {9, "b9"}, {10, EncodeValue(kTypeValue, "c10")}};
+    ASSERT_EQ(result, expect);
+    ASSERT_TRUE(iter->Ok());
+    iter->Seek(4);
+    ASSERT_TRUE(iter->Valid());
+    ASSERT_EQ(iter->Key(), 5);
+    ASSERT_EQ(iter->Value().ToString(), "a5");
+    iter->Seek(11);
+    ASSERT_FALSE(iter->Valid());
+}
+
+TEST(KVSTORE_TEST, FREEZE_AND_FLUSH_TEST) {
+    const uint64_t max_key = 20000;
+    auto options = TestOptions("kvstore_flush_test");
+    options.auto_compaction_ = false;       // SSTable的数量只随flush变化
+    CountTableFiles(options.dir_, true);
+    KvStore kvstore(options);
+    double put_cost;
+    {
+        testutils::TimeCounter put_counter(put_cost);
+        for (uint64_t key = 0; key < max_key; ++key) {
+            ASSERT_TRUE(kvstore.Put(key, TestValue(key)));
+        }
+    }
+    printf("The put cost is %lf\n", put_cost);
+    kvstore.Dump();
+    ASSERT_GT(kvstore.GetSSTableCount(), 0);
+
+    kvstore.Flush();
+    auto sstable_cnt = kvstore.GetSSTableCount();
+    ASSERT_GT(sstable_cnt, 1);
+    // 所有的数据都已经在SSTable中了
+    std::string value;
+    for (uint64_t key = 0; key < max_key; ++key) {
+        ASSERT_TRUE(kvstore.Get(key, &value));
+        ASSERT_EQ(value, TestValue(key));
+    }
+    // flush之后的写入和删除都在新的memtable中
+    ASSERT_TRUE(kvstore.Put(max_key, TestValue(max_key)));
+    ASSERT_TRUE(kvstore.Get(max_key, &value));
+    ASSERT_EQ(value, TestValue(max_key));
+    ASSERT_TRUE(kvstore.Delete(max_key));
+    ASSERT_FALSE(kvstore.Get(max_key, &value));
+    ASSERT_TRUE(kvstore.Delete(0));
+    ASSERT_FALSE(kvstore.Get(0, &value));
+    ASSERT_EQ(kvstore.GetSSTableCount(), sstable_cnt);
+}
+
+// dir中所有SSTable文件的路径
+static std::vector<std::string> ListTablePaths(const std::string &dir) {
+    std::vector<std::string> paths;
+    DIR *dirp = opendir(dir.c_str());
+    if (!dirp) {
+        return paths;
+    }
+    while (dirent *entry = readdir(dirp)) {
+        std::string name = entry->d_name;
+        if (name.size() > 4 && name.compare(name.size() - 4, 4, ".sst") == 0) {
+            paths.push_back(dir + "/" + name);
+        }
+    }
+    closedir(dirp);
+    return paths;
+}
+
+TEST(KVSTORE_TEST, FLUSH_AND_REOPEN_TEST) {
+    const uint64_t max_key = 20000;
+    const std::string dir = "kvstore_flush_reopen_test";
+    for (auto &path : ListTablePaths(dir)) {        // 上一次运行留下的文件
+        unlink(path.c_str());
+    }
+    {
+        KvStore kvstore(TestOptions(dir));
+        for (uint64_t key = 0; key < max_key; ++key) {
+            ASSERT_TRUE(kvstore.Put(key, TestValue(key)));
+        }
+        kvstore.Flush();
+        ASSERT_GT(kvstore.GetSSTableCount(), 1);
+    }
+    // 从文件重新打开flush生成的SSTable,每个key恰好在其中一个表中
+    std::vector<std::unique_ptr<SSTable>> sstables;
+    for (auto &path : ListTablePaths(dir)) {
+        sstables.emplace_back(new SSTable(SSTableId{sstables.size(), path}));
+    }
+    ASSERT_GT(sstables.size(), 1);
+    std::string value;
+    for (uint64_t key = 0; key < max_key; ++key) {
+        size_t found_cnt = 0;
+        for (auto &sstable : sstables) {
+            found_cnt += sstable->Get(key, &value, false);
+        }
+        ASSERT_EQ(found_cnt, 1);
+    }
+    for (auto &sstable : sstables) {
+        ASSERT_FALSE(sstable->Get(max_key, &value, false));
+    }
+}
+
+TEST(KVSTORE_TEST, WRITE_BATCH_TEST) {
+    CountTableFiles("kvstore_batch_test", true);
+    KvStore kvstore(TestOptions("kvstore_batch_test"));
+    WriteBatch batch;
+    for (uint64_t key = 100; key > 0; --key) {
+        batch.Put(key, TestValue(key));
+    }
+    batch.Put(50, "overwritten");
+    batch.Delete(60);
+    batch.Put(61, "first");
+    batch.Put(61, "second");
+    ASSERT_EQ(batch.Count(), 104);
+    ASSERT_TRUE(kvstore.Write(batch));
+
+    std::string value;
+    for (uint64_t key = 1; key <= 100; ++key) {
+        if (key == 50 || key == 60 || key == 61) {
+            continue;
+        }
+        ASSERT_TRUE(kvstore.Get(key, &value));
+        ASSERT_EQ(value, TestValue(key));
+    }
+    ASSERT_TRUE(kvstore.Get(50, &value));
+    ASSERT_EQ(value, "overwritten");
+    ASSERT_FALSE(kvstore.Get(60, &value));
+    ASSERT_TRUE(kvstore.Get(61, &value));
+    ASSERT_EQ(value, "second");
+}
+
+TEST(KVSTORE_TEST, COMPACTION_TEST) {
+    const uint64_t max_key = 20000;
+    const std::string dir = "kvstore_compaction_test";
+    auto options = TestOptions(dir);
+    options.level1_max_bytes_ = 256 * 1024;
+    options.target_table_size_ = 64 * 1024;
+    std::map<uint64_t, std::string> expect;
+    std::mt19937_64 rng(23);
+    CountTableFiles(dir, true);     // 清理上一次运行留下的文件
+    {
+        KvStore kvstore(options);
+        // 多轮覆盖写和删除,旧版本和墓碑分散在不同的SSTable中
+        for (int round = 0; round < 4; ++round) {
+            for (uint64_t i = 0; i < max_key; ++i) {
+                uint64_t key = rng() % max_key;
+                if (rng() % 4 == 0) {
+                    ASSERT_TRUE(kvstore.Delete(key));
+                    expect.erase(key);
+                } else {
+                    auto value = TestValue(key) + "_" + std::to_string(round);
+                    ASSERT_TRUE(kvstore.Put(key, value));
+                    expect[key] = value;
+                }
+            }
+        }
+        // 迭代器看到的是创建时的快照
+        auto snapshot = kvstore.NewIterator();
+        ASSERT_TRUE(kvstore.Put(max_key, "after snapshot"));
+        kvstore.Flush();
+        kvstore.WaitForCompaction();
+        kvstore.Dump();
+        ASSERT_LT(kvstore.GetLevelTableCount(0), options.level0_compaction_trigger_);
+        ASSERT_GT(kvstore.GetSSTableCount(), kvstore.GetLevelTableCount(0));
+        std::string value;
+        for (uint64_t key = 0; key < max_key; ++key) {
+            auto it = expect.find(key);
+            ASSERT_EQ(kvstore.Get(key, &value), it != expect.end());
+            if (it != expect.end()) {
+                ASSERT_EQ(value, it->second);
+            }
+        }
+        auto check_scan = [&](Iterator *iter) {
+            auto expect_it = expect.begin();
+            for (iter->SeekToFirst(); iter->Valid() && iter->Key() < max_key; iter->Next(), ++expect_it) {
+                ASSERT_NE(expect_it, expect.end());
+                ASSERT_EQ(iter->Key(), expect_it->first);
+                ASSERT_EQ(iter->Value().ToString(), expect_it->second);
+            }
+            ASSERT_EQ(expect_it, expect.end());
+            ASSERT_TRUE(iter->Ok());
+        };
+        // 快照持有被合并掉的SSTable,它们的文件在快照释放之后才删除
+        check_scan(snapshot.get());
+        snapshot->Seek(max_key);
+        ASSERT_FALSE(snapshot->Valid());
+        ASSERT_GT(CountTableFiles(dir), kvstore.GetSSTableCount());
+        snapshot.reset();
+        ASSERT_EQ(CountTableFiles(dir), kvstore.GetSSTableCount());
+        auto iter = kvstore.NewIterator();
+        check_scan(iter.get());
+        iter->Seek(max_key);
+        ASSERT_TRUE(iter->Valid());
+        ASSERT_EQ(iter->Value().ToString(), "after snapshot");
+    }
+}
+
+TEST(KVSTORE_TEST, SUBCOMPACTION_TEST) {
+    const uint64_t max_key = 20000;
+    const std::string dir = "kvstore_subcompaction_test";
+    auto options = TestOptions(dir);
+    options.level1_max_bytes_ = 256 * 1024;
+    options.target_table_size_ = 32 * 1024;
+    options.max_subcompactions_ = 4;
+    std::map<uint64_t, std::string> expect;
+    std::mt19937_64 rng(29);
+    CountTableFiles(dir, true);
+    {
+        KvStore kvstore(options);
+        for (int round = 0; round < 4; ++round) {
+            for (uint64_t i = 0; i < max_key; ++i) {
+                uint64_t key = rng() % max_key;
+                if (rng() % 4 == 0) {
+                    ASSERT_TRUE(kvstore.Delete(key));
+                    expect.erase(key);
+                } else {
+                    auto value = TestValue(key) + "_" + std::to_string(round);
+                    ASSERT_TRUE(kvstore.Put(key, value));
+                    expect[key] = value;
+                }
+            }
+        }
+        kvstore.Flush();
+        kvstore.WaitForCompaction();
+        auto stats = kvstore.GetCompactionStats();
+        std::cout << "compactions: " << stats.compaction_cnt_ << ", subcompactions: " << stats.subcompaction_cnt_
+                  << ", trivial moves: " << stats.trivial_move_cnt_ << ", read: " << stats.bytes_read_
+                  << ", written: " << stats.bytes_written_ << std::endl;
+        ASSERT_GT(stats.compaction_cnt_, 0);
+        ASSERT_GT(stats.subcompaction_cnt_, stats.compaction_cnt_);
+        ASSERT_LE(stats.subcompaction_cnt_, stats.compaction_cnt_ * options.max_subcompactions_);
+        // 各段的输出拼接之后每层仍然有序并且互不重叠,扫描结果和逐个查询都和预期一致
+        std::string value;
+        for (uint64_t key = 0; key < max_key; ++key) {
+            auto it = expect.find(key);
+            ASSERT_EQ(kvstore.Get(key, &value), it != expect.end());
+            if (it != expect.end()) {
+                ASSERT_EQ(value, it->second);
+            }
+        }
+        auto iter = kvstore.NewIterator();
+        auto expect_it = expect.begin();
+        for (iter->SeekToFirst(); iter->Valid(); iter->Next(), ++expect_it) {
+            ASSERT_NE(expect_it, expect.end());
+            ASSERT_EQ(iter->Key(), expect_it->first);
+            ASSERT_EQ(iter->Value().ToString(), expect_it->second);
+        }
+        ASSERT_EQ(expect_it, expect.end());
+        ASSERT_TRUE(iter->Ok());
+        iter.reset();
+        ASSERT_EQ(CountTableFiles(dir), kvstore.GetSSTableCount());
+    }
+}
+
+TEST(KVSTORE_TEST, REOPEN_TEST) {
+    const uint64_t max_key = 20000;
+    const std::string dir = "kvstore_reopen_test";
+    auto options = TestOptions(dir);
+    options.level1_max_bytes_ = 256 * 1024;
+    options.target_table_size_ = 16 * 1024;
+    options.index_cache_size_ = 32 * 1024;
+    std::mt19937_64 rng(31);
+    std::map<uint64_t, std::string> expect;
+    std::vector<size_t> level_table_cnts;
+    CountTableFiles(dir, true);
+    {
+        KvStore kvstore(options);
+        for (uint64_t i = 0; i < max_key * 2; ++i) {
+            uint64_t key = rng() % max_key;
+            if (rng() % 4 == 0) {
+                ASSERT_TRUE(kvstore.Delete(key));
+                expect.erase(key);
+            } else {
+                auto value = TestValue(key) + "_" + std::to_string(i);
+                ASSERT_TRUE(kvstore.Put(key, value));
+                expect[key] = value;
+            }
+        }
+        kvstore.Flush();
+        kvstore.WaitForCompaction();
+        for (int level = 0; level < KvStore::kNumLevels; ++level) {
+            level_table_cnts.push_back(kvstore.GetLevelTableCount(level));
+        }
+        // 关闭时memtable中剩下的数据flush成新的SSTable
+        ASSERT_TRUE(kvstore.Put(max_key, "unflushed"));
+        ++level_table_cnts[0];
+        expect[max_key] = "unflushed";
+    }
+    // 崩溃前没有完成的合并留下的文件不在manifest中
+    std::string orphan = dir + "/" + std::to_string(1000000) + ".sst";
+    FILE *orphan_file = fopen(orphan.c_str(), "w");
+    ASSERT_NE(orphan_file, nullptr);
+    fclose(orphan_file);
+    for (int round = 0; round < 2; ++round) {
+        double open_cost;
+        std::unique_ptr<KvStore> kvstore;
+        {
+            testutils::TimeCounter open_counter(open_cost);
+            kvstore.reset(new KvStore(options));
+        }
+        printf("The open cost of %zu sstables is %lf\n", kvstore->GetSSTableCount(), open_cost);
+        ASSERT_EQ(CountTableFiles(dir), kvstore->GetSSTableCount());
+        if (round == 0) {
+            for (int level = 0; level < KvStore::kNumLevels; ++level) {
+                ASSERT_EQ(kvstore->GetLevelTableCount(level), level_table_cnts[level]);
+            }
+        }
+        ASSERT_EQ(kvstore->GetIndexCacheUsage(), 0);       // 打开时没有加载任何索引
+        std::string value;
+        for (uint64_t key = 0; key <= max_key; ++key) {
+            auto it = expect.find(key);
+            ASSERT_EQ(kvstore->Get(key, &value), it != expect.end());
+            if (it != expect.end()) {
+                ASSERT_EQ(value, it->second);
+            }
+        }
+        // 索引的总大小不超过上限,超过时最久没有使用的被淘汰
+        printf("The index cache usage is %zu\n", kvstore->GetIndexCacheUsage());
+        ASSERT_GT(kvstore->GetIndexCacheUsage(), 0);
+        ASSERT_LE(kvstore->GetIndexCacheUsage(), options.index_cache_size_);
+        auto iter = kvstore->NewIterator();
+        auto expect_it = expect.begin();
+        for (iter->SeekToFirst(); iter->Valid(); iter->Next(), ++expect_it) {
+            ASSERT_NE(expect_it, expect.end());
+            ASSERT_EQ(iter->Key(), expect_it->first);
+            ASSERT_EQ(iter->Value().ToString(), expect_it->second);
+        }
+        ASSERT_EQ(expect_it, expect.end());
+        // 第二轮打开的是合并之后的版本
+        kvstore->WaitForCompaction();
+    }
+}
+
+TEST(KVSTORE_TEST, FLUSH_ERROR_TEST) {
+    const uint64_t max_key = 100000;
+    const std::string dir = "kvstore_flush_error_test";
+    auto options = TestOptions(dir);
+    options.max_immutable_cnt_ = 1;
+    std::string blocker = dir + "/0.sst";
+    rmdir(blocker.c_str());
+    CountTableFiles(dir, true);
+    uint64_t accepted = 0;
+    {
+        KvStore kvstore(options);
+        // 第一个SSTable的路径被目录占用,flush写文件失败
+        ASSERT_EQ(mkdir(blocker.c_str(), 0755), 0);
+        // flush停止之后等待flush的memtable达到上限,写入被拒绝而不是一直阻塞
+        while (accepted < max_key && kvstore.Put(accepted, TestValue(accepted))) {
+            ++accepted;
+        }
+        ASSERT_LT(accepted, max_key);
+        ASSERT_FALSE(kvstore.Flush());
+        ASSERT_EQ(kvstore.GetSSTableCount(), 0);
+        // 没有flush的memtable仍然可读
+        std::string value;
+        for (uint64_t key = 0; key < accepted; ++key) {
+            ASSERT_TRUE(kvstore.Get(key, &value));
+            ASSERT_EQ(value, TestValue(key));
+        }
+        ASSERT_FALSE(kvstore.Get(accepted, &value));
+        ASSERT_EQ(rmdir(blocker.c_str()), 0);
+    }
+    // 关闭时再次尝试flush,之前的数据没有丢失
+    KvStore kvstore(options);
+    ASSERT_GT(kvstore.GetSSTableCount(), 0);
+    std::string value;
+    for (uint64_t key = 0; key < accepted; ++key) {
+        ASSERT_TRUE(kvstore.Get(key, &value));
+        ASSERT_EQ(value, TestValue(key));
+    }
+}
+
+TEST(KVSTORE_TEST, MANIFEST_ERROR_TEST) {
+    const uint64_t max_key = 2000;
+    const std::string dir = "kvstore_manifest_error_test";
+    auto options = TestOptions(dir);
+    std::string blocker = dir + "/MANIFEST.tmp";
+    rmdir(blocker.c_str());
+    CountTableFiles(dir, true);
+    {
+        KvStore kvstore(options);
+        // manifest的临时文件被目录占用,SSTable写成功了但是不能记录到manifest中
+        ASSERT_EQ(mkdir(blocker.c_str(), 0755), 0);
+        for (uint64_t key = 0; key < max_key; ++key) {
+            ASSERT_TRUE(kvstore.Put(key, TestValue(key)));
+        }
+        ASSERT_FALSE(kvstore.Flush());
+        ASSERT_EQ(kvstore.GetSSTableCount(), 0);
+        ASSERT_EQ(CountTableFiles(dir), 0);
+        std::string value;
+        for (uint64_t key = 0; key < max_key; ++key) {
+            ASSERT_TRUE(kvstore.Get(key, &value));
+            ASSERT_EQ(value, TestValue(key));
+        }
+        ASSERT_EQ(rmdir(blocker.c_str()), 0);
+    }
+    KvStore kvstore(options);
+    ASSERT_GT(kvstore.GetSSTableCount(), 0);
+    std::string value;
+    for (uint64_t key = 0; key < max_key; ++key) {
+        ASSERT_TRUE(kvstore.Get(key, &value));
+        ASSERT_EQ(value, TestValue(key));
+    }
+}
+
+TEST(KVSTORE_TEST, PARALLEL_OPEN_TEST) {
+    const uint64_t max_key = 50000;
+    const std::string dir = "kvstore_parallel_open_test";
+    auto options = TestOptions(dir);
+    options.auto_compaction_ = false;
+    options.index_cache_size_ = 64 * 1024 * 1024;       // 能容纳所有的索引,用它的大小判断索引是否已经加载
+    CountTableFiles(dir, true);
+    {
+        KvStore kvstore(options);
+        for (uint64_t key = 0; key < max_key; ++key) {
+            ASSERT_TRUE(kvstore.Put(key, TestValue(key)));
+        }
+    }
+    size_t table_cnt = CountTableFiles(dir);
+    ASSERT_GT(table_cnt, 1);
+    for (size_t open_threads : {1, 4}) {
+        for (bool preload : {false, true}) {
+            options.open_threads_ = open_threads;
+            options.preload_indexes_ = preload;
+            std::vector<std::pair<size_t, size_t>> progress;
+            options.open_progress_ = [&](size_t opened, size_t total) {
+                progress.emplace_back(opened, total);
+            };
+            double open_cost;
+            std::unique_ptr<KvStore> kvstore;
+            {
+                testutils::TimeCounter open_counter(open_cost);
+                kvstore.reset(new KvStore(options));
+            }
+            printf("The open cost of %zu sstables with %zu threads, preload %d is %lf\n",
+                   table_cnt, open_threads, preload, open_cost);
+            // 每个表报告一次,已经打开的数量依次递增
+            ASSERT_EQ(progress.size(), table_cnt);
+            for (size_t i = 0; i < progress.size(); ++i) {
+                ASSERT_EQ(progress[i], std::make_pair(i + 1, table_cnt));
+            }
+            ASSERT_EQ(kvstore->GetIndexCacheUsage() > 0, preload);
+            std::string value;
+            for (uint64_t key = 0; key < max_key; key += 7) {
+                ASSERT_TRUE(kvstore->Get(key, &value));
+                ASSERT_EQ(value, TestValue(key));
+            }
+            ASSERT_GT(kvstore->GetIndexCacheUsage(), 0);
+        }
+    }
+}
+
+int main(int argc, char* argv[]) {
+    testing::InitGoogleTest(&argc, argv);
+    RUN_ALL_TESTS();
+    return 0;
+}
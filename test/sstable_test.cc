@@ -0,0 +1,1118 @@
+//
+// Created by 杨丰硕 on 2023/3/20.
+//
+#include <fstream>
+#include <random>
+#include <string>
+#include <sys/stat.h>
+#include <gtest/gtest.h>
+#include "../src/SSTable.h"
+#include "../src/BlockCache.h"
+#include "../src/IndexCache.h"
+#include "../src/Block.h"
+#include "../src/Coding.h"
+#include "../src/SSTableBuilder.h"
+#include "../src/Compression.h"
+#include "../src/Crc32c.h"
+#include "../src/DiskStorage.h"
+#include "../src/KeySearch.h"
+#include "../src/LearnedIndex.h"
+#include "test_utils.h"
+
+using namespace kvstore;
+
+static std::string TestValue(uint64_t key) {
+    return "value_" + std::to_string(key) + std::string(key % 100, 'v');
+}
+
+// 把文件中offset处的一个字节取反
+static void CorruptByte(const std::string &path, uint64_t offset) {
+    std::fstream file(path, std::ios::in | std::ios::out | std::ios::binary);
+    file.seekg(offset);
+    char byte = static_cast<char>(file.get());
+    file.seekp(offset);
+    file.put(static_cast<char>(~byte));
+}
+
+static SSTableOptions CacheOptions(BlockCache *cache) {
+    SSTableOptions options;
+    options.block_cache_ = cache;
+    return options;
+}
+
+static std::string JsonValue(uint64_t key) {
+    return "{\"id\": " + std::to_string(key) + ", \"name\": \"user_" + std::to_string(key % 977)
+           + "\", \"tags\": [\"alpha\", \"beta\", \"gamma\"], \"active\": " + (key % 2 ? "true" : "false") + "}";
+}
+
+static void FillSkipList(SSTable::KvContainer *sklist, uint64_t max_key, uint64_t step) {
+    for (uint64_t key = 0; key < max_key; key += step) {
+        sklist->Put(key, TestValue(key));
+    }
+}
+
+TEST(BLOCKCACHE_TEST, LRU_TEST) {
+    BlockCache cache(1024, 0);      // 只有一个分片,方便检查淘汰顺序
+    auto block = [](char c) {
+        return std::make_shared<const std::string>(256, c);
+    };
+    ASSERT_EQ(cache.Lookup(1, 0), nullptr);
+    for (uint64_t blockno = 0; blockno < 4; ++blockno) {
+        cache.Insert(1, blockno, block('a' + blockno));
+    }
+    ASSERT_EQ(cache.GetUsage(), 1024);
+    ASSERT_EQ(*cache.Lookup(1, 0), std::string(256, 'a'));      // 0被访问之后1成为最久没有使用的
+    cache.Insert(2, 0, block('z'));
+    ASSERT_EQ(cache.Lookup(1, 1), nullptr);
+    ASSERT_NE(cache.Lookup(1, 0), nullptr);
+    ASSERT_NE(cache.Lookup(2, 0), nullptr);
+    ASSERT_EQ(cache.GetUsage(), 1024);
+    // 重复插入同一个block不会重复计算
+    cache.Insert(2, 0, block('y'));
+    ASSERT_EQ(*cache.Lookup(2, 0), std::string(256, 'y'));
+    ASSERT_EQ(cache.GetUsage(), 1024);
+}
+
+TEST(BLOOMFILTER_TEST, FALSE_POSITIVE_TEST) {
+    const uint64_t key_cnt = 10000;
+    BloomFilter builder(10);
+    for (uint64_t key = 0; key < key_cnt; ++key) {
+        builder.AddKey(key * 2);
+    }
+    std::string filter_data = builder.Finish();
+    Slice filter(filter_data);
+    ASSERT_EQ(builder.GetKeyCount(), 0);
+    for (uint64_t key = 0; key < key_cnt; ++key) {      // 不会漏掉存在的key
+        ASSERT_TRUE(BloomFilter::KeyMayMatch(key * 2, filter));
+    }
+    size_t false_positive = 0;
+    for (uint64_t key = 0; key < key_cnt; ++key) {
+        false_positive += BloomFilter::KeyMayMatch(key * 2 + 1, filter);
+    }
+    printf("The false positive rate is %lf\n", static_cast<double>(false_positive) / key_cnt);
+    ASSERT_LT(false_positive, key_cnt * 2 / 100);
+    ASSERT_TRUE(BloomFilter::KeyMayMatch(1, Slice()));
+}
+
+TEST(BLOCK_TEST, COMPACT_BLOCK_TEST) {
+    for (BlockFormat format : {kRawFormat, kCompactFormat}) {
+        BlockBuilder builder(format, 4);
+        for (uint64_t key = 10; key < 1000; key += 10) {
+            builder.Add(key, key % 30 == 0 ? std::string() : TestValue(key));
+        }
+        std::string contents = builder.Finish();
+        ASSERT_TRUE(builder.Empty());
+        BlockReader reader(Slice(contents), format);
+        ASSERT_TRUE(reader.Valid());
+        ASSERT_EQ(reader.GetEntryCount(), 99);
+        Slice value;
+        for (uint64_t key = 0; key < 1010; ++key) {
+            size_t index = reader.LowerBound(key);
+            ASSERT_EQ(index, (key + 9) / 10 == 0 ? 0 : std::min<size_t>((key + 9) / 10 - 1, 99));
+            if (key % 10 == 0 && key >= 10 && key < 1000) {
+                ASSERT_TRUE(reader.Get(key, &value));
+                ASSERT_EQ(value.ToString(), key % 30 == 0 ? std::string() : TestValue(key));
+                ASSERT_EQ(reader.KeyAt(index), key);
+                ASSERT_EQ(reader.ValueAt(index).ToString(), value.ToString());
+            } else {
+                ASSERT_FALSE(reader.Get(key, &value));
+            }
+        }
+    }
+    ASSERT_FALSE(BlockReader(Slice("ab", 2), kCompactFormat).Valid());
+}
+
+TEST(BLOCK_TEST, CORRUPTED_OFFSET_TEST) {
+    BlockBuilder builder(kRawFormat);
+    for (uint64_t key = 1; key <= 10; ++key) {
+        builder.Add(key, TestValue(key));
+    }
+    std::string contents = builder.Finish();
+    const size_t offsets_pos = contents.size() - sizeof(uint64_t) * 11;
+    // 第5个entry的offset越过整个block,第8个entry的offset比第7个小
+    std::string corrupted = contents;
+    EncodeFixed64(&corrupted[offsets_pos + 4 * sizeof(uint64_t)], contents.size() * 2);
+    EncodeFixed64(&corrupted[offsets_pos + 7 * sizeof(uint64_t)], 0);
+    BlockReader reader(Slice(corrupted), kRawFormat);
+    ASSERT_TRUE(reader.Valid());
+    Slice value;
+    for (uint64_t key = 1; key <= 10; ++key) {
+        if (key == 4 || key == 5 || key == 7) {         // value的起点或终点越界,或者终点在起点之前
+            ASSERT_FALSE(reader.Get(key, &value));
+            ASSERT_EQ(reader.ValueAt(key - 1).size_, 0);
+        } else if (key == 8) {      // 起点被改小但没有越界,只能保证读到的还在value区域内
+            ASSERT_TRUE(reader.Get(key, &value));
+            ASSERT_EQ(value.data_, corrupted.data());
+            ASSERT_LE(value.size_, offsets_pos - sizeof(uint64_t) * 10);
+        } else {
+            ASSERT_TRUE(reader.Get(key, &value));
+            ASSERT_EQ(value.ToString(), TestValue(key));
+        }
+    }
+    std::vector<uint64_t> keys;
+    std::vector<Slice> values;
+    ASSERT_FALSE(reader.DecodeEntries(&keys, &values));
+    ASSERT_TRUE(BlockReader(Slice(contents), kRawFormat).DecodeEntries(&keys, &values));
+    ASSERT_EQ(keys.size(), 10);
+}
+
+TEST(COMPRESSION_TEST, ROUND_TRIP_TEST) {
+    std::mt19937_64 rng(17);
+    std::string random_data(10000, '\0');
+    for (auto &c : random_data) {
+        c = static_cast<char>(rng());
+    }
+    std::string json_data;
+    for (uint64_t key = 0; key < 100; ++key) {
+        json_data += JsonValue(key);
+    }
+    std::vector<std::string> inputs = {std::string(), "a", "abcd", std::string(100000, 'x'),
+                                       "abcabcabcabcabcabcabcabcab", random_data, json_data};
+    for (CompressionType type : {kNoCompression, kLZCompression, kZlibCompression}) {
+        if (!IsCompressionSupported(type)) {
+            printf("Compression type %d is not supported\n", type);
+            ASSERT_FALSE(Compress(type, "a", 1, &random_data));
+            continue;
+        }
+        for (auto &input : inputs) {
+            std::string compressed, uncompressed;
+            ASSERT_TRUE(Compress(type, input.data(), input.size(), &compressed));
+            ASSERT_TRUE(Uncompress(type, compressed.data(), compressed.size(), &uncompressed));
+            ASSERT_EQ(uncompressed, input);
+        }
+        std::string compressed, uncompressed;
+        ASSERT_TRUE(Compress(type, json_data.data(), json_data.size(), &compressed));
+        printf("Compression type %d: %zu -> %zu\n", type, json_data.size(), compressed.size());
+        if (type != kNoCompression) {
+            ASSERT_LT(compressed.size() * 3, json_data.size());
+            // 截断的数据不能被解压,也不能越界
+            for (size_t size = 0; size < compressed.size(); size += 7) {
+                ASSERT_FALSE(Uncompress(type, compressed.data(), size, &uncompressed));
+            }
+        }
+    }
+}
+
+TEST(CRC32C_TEST, VALUE_TEST) {
+    ASSERT_EQ(Crc32c("", 0), 0u);
+    ASSERT_EQ(Crc32c("123456789", 9), 0xe3069283u);
+    std::string zeros(32, '\0'), ones(32, '\xff');
+    ASSERT_EQ(Crc32c(zeros.data(), zeros.size()), 0x8a9136aau);
+    ASSERT_EQ(Crc32c(ones.data(), ones.size()), 0x62a8ab43u);
+    printf("SSE4.2 is %s\n", HasHardwareCrc32c() ? "supported" : "not supported");
+    std::mt19937_64 rng(17);
+    std::string data;
+    for (int i = 0; i < 5000; ++i) {
+        data.push_back(static_cast<char>(rng()));
+    }
+    for (size_t split = 0; split <= data.size(); split += 37) {     // 覆盖硬件路径按768字节分轮的各种边界
+        uint32_t crc = ExtendCrc32c(Crc32c(data.data(), split), data.data() + split, data.size() - split);
+        ASSERT_EQ(crc, Crc32c(data.data(), data.size()));
+        ASSERT_EQ(PortableExtendCrc32c(0, data.data() + split, data.size() - split),
+                  Crc32c(data.data() + split, data.size() - split));
+    }
+}
+
+TEST(KEY_SEARCH_TEST, LAYOUT_TEST) {
+    std::mt19937_64 rng(7);
+    for (size_t size : {0, 1, 7, 8, 9, 63, 64, 65, 1000, 4097}) {
+        std::vector<uint64_t> keys;
+        for (size_t i = 0; i < size; ++i) {
+            keys.push_back(i * 10 + 5);
+        }
+        keys.push_back(UINT64_MAX);     // 和B树的填充值相同的key
+        for (SearchLayout layout : {kSortedLayout, kEytzingerLayout, kBTreeLayout, kAutoLayout}) {
+            KeySearcher searcher;
+            searcher.Build(keys, layout);
+            ASSERT_EQ(searcher.Size(), keys.size());
+            ASSERT_NE(searcher.GetLayout(), kAutoLayout);
+            for (uint64_t key = 0; key < size * 10 + 20; ++key) {
+                size_t expect = std::lower_bound(keys.begin(), keys.end(), key) - keys.begin();
+                ASSERT_EQ(searcher.LowerBound(key), expect);
+            }
+            for (int i = 0; i < 100; ++i) {
+                uint64_t key = rng();
+                size_t expect = std::lower_bound(keys.begin(), keys.end(), key) - keys.begin();
+                ASSERT_EQ(searcher.LowerBound(key), expect);
+            }
+            ASSERT_EQ(searcher.LowerBound(UINT64_MAX), keys.size() - 1);
+        }
+    }
+}
+
+// 只输出耗时,正确性由LAYOUT_TEST检查,需要时用--gtest_also_run_disabled_tests运行
+TEST(KEY_SEARCH_TEST, DISABLED_LAYOUT_BENCH) {
+    const size_t key_cnt = 8 * 1024 * 1024, lookup_cnt = 2 * 1024 * 1024;
+    std::mt19937_64 rng(11);
+    std::vector<uint64_t> keys(key_cnt);
+    for (size_t i = 0; i < key_cnt; ++i) {
+        keys[i] = i * 16 + rng() % 16;     // 接近线性分布的id
+    }
+    std::vector<uint64_t> lookups(lookup_cnt);
+    for (auto &key : lookups) {
+        key = rng() % (key_cnt * 16);
+    }
+    printf("AVX2 is %s\n", KeySearcher::HasAvx2() ? "supported" : "not supported");
+    size_t expect_sum = 0;
+    double cost;
+    {
+        testutils::TimeCounter counter(cost);
+        for (auto key : lookups) {
+            expect_sum += std::lower_bound(keys.begin(), keys.end(), key) - keys.begin();
+        }
+    }
+    printf("The std::lower_bound cost is %lf\n", cost);
+    const char *names[] = {"sorted", "eytzinger", "btree"};
+    for (SearchLayout layout : {kSortedLayout, kEytzingerLayout, kBTreeLayout}) {
+        KeySearcher searcher;
+        searcher.Build(keys, layout);
+        size_t sum = 0;
+        {
+            testutils::TimeCounter counter(cost);
+            for (auto key : lookups) {
+                sum += searcher.LowerBound(key);
+            }
+        }
+        printf("The %s layout cost is %lf\n", names[layout], cost);
+        ASSERT_EQ(sum, expect_sum);
+    }
+    LearnedIndex learned_index;
+    learned_index.Build(keys, 8);
+    size_t sum = 0;
+    {
+        testutils::TimeCounter counter(cost);
+        for (auto key : lookups) {
+            size_t begin, end;
+            learned_index.Predict(key, &begin, &end);
+            sum += std::lower_bound(keys.begin() + begin, keys.begin() + end, key) - keys.begin();
+        }
+    }
+    printf("The learned index cost is %lf, %zu segments, %zu bytes\n", cost,
+           learned_index.GetSegmentCount(), learned_index.MemoryUsage());
+    ASSERT_EQ(sum, expect_sum);
+}
+
+TEST(KEY_SEARCH_TEST, LEARNED_INDEX_TEST) {
+    std::mt19937_64 rng(13);
+    std::vector<std::vector<uint64_t>> key_sets(3);
+    for (uint64_t i = 0; i < 10000; ++i) {
+        key_sets[0].push_back(i * 3);                        // 完全线性
+        key_sets[1].push_back(i * 64 + rng() % 64);          // 接近线性
+        key_sets[2].push_back(i < 5000 ? i : i * i * 1000);  // 分布突变
+    }
+    key_sets[2].push_back(UINT64_MAX);
+    for (auto &keys : key_sets) {
+        for (size_t max_error : {1, 4, 32}) {
+            LearnedIndex learned_index;
+            learned_index.Build(keys, max_error);
+            std::string encoded;
+            learned_index.EncodeTo(&encoded);
+            LearnedIndex decoded;
+            ASSERT_TRUE(decoded.DecodeFrom(Slice(encoded), keys.size()));
+            ASSERT_EQ(decoded.GetSegmentCount(), learned_index.GetSegmentCount());
+            ASSERT_FALSE(decoded.DecodeFrom(Slice(encoded.data(), encoded.size() - 1), keys.size()));
+            std::vector<uint64_t> probes{0, UINT64_MAX};
+            for (auto key : keys) {
+                probes.push_back(key);
+                probes.push_back(key + 1);
+                probes.push_back(key - 1);
+            }
+            for (int i = 0; i < 1000; ++i) {
+                probes.push_back(rng());
+            }
+            for (auto key : probes) {
+                size_t expect = std::lower_bound(keys.begin(), keys.end(), key) - keys.begin();
+                size_t begin, end;
+                learned_index.Predict(key, &begin, &end);
+                ASSERT_LE(begin, expect);
+                ASSERT_GE(end, expect);
+                ASSERT_LE(end - begin, max_error * 2 + 3);
+            }
+        }
+    }
+    LearnedIndex linear;
+    linear.Build(key_sets[0], 1);
+    ASSERT_EQ(linear.GetSegmentCount(), 1);
+}
+
+TEST(SSTABLE_TEST, LOAD_VALUE_TEST) {
+    const uint64_t max_key = 30000;
+    SSTable::KvContainer sklist;
+    FillSkipList(&sklist, max_key, 3);
+    BlockCache cache(64 * 1024 * 1024);
+    SSTable sstable(sklist, SSTableId{1, "sstable_load_test.sst"}, CacheOptions(&cache));
+    ASSERT_EQ(sstable.GetEntryCount(), max_key / 3);
+    ASSERT_GT(sstable.GetBlockCount(), 1);
+
+    std::string value;
+    for (uint64_t key = 0; key < max_key; ++key) {
+        if (key % 3 == 0) {
+            ASSERT_TRUE(sstable.Get(key, &value, true));
+            ASSERT_EQ(value, TestValue(key));
+        } else {
+            ASSERT_FALSE(sstable.Get(key, &value, true));
+        }
+    }
+    ASSERT_FALSE(sstable.Get(max_key * 2, &value, true));
+
+    std::string block;
+    ASSERT_TRUE(sstable.LoadBlock(0, &block));
+    ASSERT_EQ(block.substr(0, TestValue(0).size()), TestValue(0));
+    ASSERT_FALSE(sstable.LoadBlock(sstable.GetBlockCount(), &block));
+}
+
+TEST(SSTABLE_TEST, REOPEN_AND_CACHE_TEST) {
+    const uint64_t max_key = 100000;
+    {
+        SSTable::KvContainer sklist;
+        FillSkipList(&sklist, max_key, 1);
+        SSTable sstable(sklist, SSTableId{2, "sstable_reopen_test.sst"});
+    }
+    BlockCache cache(64 * 1024 * 1024);
+    SSTable cached_sstable(SSTableId{2, "sstable_reopen_test.sst"}, CacheOptions(&cache));
+    SSTable uncached_sstable(SSTableId{2, "sstable_reopen_test.sst"});
+    ASSERT_EQ(cached_sstable.GetEntryCount(), max_key);
+
+    std::string value;
+    for (uint64_t key = 0; key < max_key; ++key) {      // 顺便把所有block都放进cache
+        ASSERT_TRUE(cached_sstable.Get(key, &value, true));
+        ASSERT_EQ(value, TestValue(key));
+    }
+    double cached_cost, uncached_cost;
+    {
+        testutils::TimeCounter uncached_counter(uncached_cost);
+        for (uint64_t key = 0; key < max_key; key += 7) {
+            ASSERT_TRUE(uncached_sstable.Get(key, &value, true));
+        }
+    }
+    printf("The uncached get cost is %lf\n", uncached_cost);
+    {
+        testutils::TimeCounter cached_counter(cached_cost);
+        for (uint64_t key = 0; key < max_key; key += 7) {
+            ASSERT_TRUE(cached_sstable.Get(key, &value, true));
+        }
+    }
+    printf("The cached get cost is %lf\n", cached_cost);
+}
+
+TEST(SSTABLE_TEST, MMAP_TEST) {
+    const uint64_t max_key = 50000;
+    SSTable::KvContainer sklist;
+    FillSkipList(&sklist, max_key, 2);
+    SSTableOptions mmap_options;
+    mmap_options.use_mmap_ = true;
+    SSTable built_sstable(sklist, SSTableId{3, "sstable_mmap_test.sst"}, mmap_options);
+    SSTable mmap_sstable(SSTableId{3, "sstable_mmap_test.sst"}, mmap_options);
+    SSTable pread_sstable(SSTableId{3, "sstable_mmap_test.sst"});
+    ASSERT_TRUE(built_sstable.IsMapped());
+    ASSERT_TRUE(mmap_sstable.IsMapped());
+    ASSERT_FALSE(pread_sstable.IsMapped());
+    ASSERT_EQ(mmap_sstable.GetEntryCount(), max_key / 2);
+    ASSERT_EQ(mmap_sstable.GetBlockCount(), pread_sstable.GetBlockCount());
+
+    Slice slice;
+    std::string value;
+    for (uint64_t key = 0; key < max_key; ++key) {
+        if (key % 2 == 0) {
+            ASSERT_TRUE(mmap_sstable.Get(key, &slice));
+            ASSERT_EQ(slice.ToString(), TestValue(key));
+            ASSERT_TRUE(built_sstable.Get(key, &value, true));
+            ASSERT_EQ(value, TestValue(key));
+        } else {
+            ASSERT_FALSE(mmap_sstable.Get(key, &slice));
+        }
+    }
+    std::string mapped_block, pread_block;
+    for (size_t blockno = 0; blockno < mmap_sstable.GetBlockCount(); ++blockno) {
+        ASSERT_TRUE(mmap_sstable.LoadBlock(blockno, &mapped_block));
+        ASSERT_TRUE(pread_sstable.LoadBlock(blockno, &pread_block));
+        ASSERT_EQ(mapped_block, pread_block);
+    }
+    ASSERT_FALSE(mmap_sstable.LoadBlock(mmap_sstable.GetBlockCount(), &mapped_block));
+
+    double mmap_cost, pread_cost;
+    {
+        testutils::TimeCounter pread_counter(pread_cost);
+        for (uint64_t key = 0; key < max_key; key += 2) {
+            ASSERT_TRUE(pread_sstable.Get(key, &value, true));
+        }
+    }
+    printf("The pread get cost is %lf\n", pread_cost);
+    mmap_sstable.AdviseAccess(true);
+    {
+        testutils::TimeCounter mmap_counter(mmap_cost);
+        for (uint64_t key = 0; key < max_key; key += 2) {
+            ASSERT_TRUE(mmap_sstable.Get(key, &slice));
+        }
+    }
+    printf("The mmap get cost is %lf\n", mmap_cost);
+}
+
+TEST(SSTABLE_TEST, BLOOM_FILTER_TEST) {
+    const uint64_t max_key = 40000;
+    {
+        SSTable::KvContainer sklist;
+        FillSkipList(&sklist, max_key, 4);
+        SSTable sstable(sklist, SSTableId{4, "sstable_bloom_test.sst"});
+        ASSERT_GT(sstable.GetFilterSize(), 0);
+    }
+    SSTableOptions mmap_options;
+    mmap_options.use_mmap_ = true;
+    SSTable pread_sstable(SSTableId{4, "sstable_bloom_test.sst"});
+    SSTable mmap_sstable(SSTableId{4, "sstable_bloom_test.sst"}, mmap_options);
+    SSTableOptions no_filter_options;
+    no_filter_options.bloom_bits_per_key_ = 0;
+    SSTable::KvContainer sklist;
+    FillSkipList(&sklist, max_key, 4);
+    SSTable no_filter_sstable(sklist, SSTableId{5, "sstable_no_bloom_test.sst"}, no_filter_options);
+    ASSERT_EQ(no_filter_sstable.GetFilterSize(), 0);
+
+    std::string value;
+    size_t false_positive = 0;
+    for (uint64_t key = 0; key < max_key; ++key) {
+        bool exist = key % 4 == 0;
+        for (SSTable *sstable : {&pread_sstable, &mmap_sstable, &no_filter_sstable}) {
+            ASSERT_EQ(sstable->Get(key, &value, true), exist);
+            if (exist) {
+                ASSERT_EQ(value, TestValue(key));
+            }
+        }
+        if (!exist) {
+            false_positive += pread_sstable.KeyMayMatch(key);
+        }
+        ASSERT_EQ(pread_sstable.KeyMayMatch(key), mmap_sstable.KeyMayMatch(key));
+    }
+    ASSERT_LT(false_positive, max_key * 3 / 4 * 2 / 100);
+    // filter在数据之后,不能被当作最后一个block的一部分
+    std::string block;
+    size_t last_block = pread_sstable.GetBlockCount() - 1;
+    ASSERT_TRUE(pread_sstable.LoadBlock(last_block, &block));
+    BlockReader reader((Slice(block)));
+    ASSERT_TRUE(reader.Valid());
+    ASSERT_EQ(reader.KeyAt(reader.GetEntryCount() - 1), max_key - 4);
+
+    double filter_cost, no_filter_cost;
+    {
+        testutils::TimeCounter no_filter_counter(no_filter_cost);
+        for (uint64_t key = 1; key < max_key; key += 4) {
+            no_filter_sstable.Get(key, &value, true);
+        }
+    }
+    printf("The absent get cost without filter is %lf\n", no_filter_cost);
+    {
+        testutils::TimeCounter filter_counter(filter_cost);
+        for (uint64_t key = 1; key < max_key; key += 4) {
+            pread_sstable.Get(key, &value, true);
+        }
+    }
+    printf("The absent get cost with filter is %lf\n", filter_cost);
+}
+
+TEST(SSTABLE_TEST, SPARSE_INDEX_TEST) {
+    const uint64_t max_key = 100000;
+    SSTable::KvContainer sklist;
+    for (uint64_t key = 0; key < max_key; ++key) {
+        sklist.Put(key * 3, std::to_string(key));       // 很短的value,每个block中有很多entry
+    }
+    SSTable sstable(sklist, SSTableId{6, "sstable_sparse_index_test.sst"});
+    SSTable reopened_sstable(SSTableId{6, "sstable_sparse_index_test.sst"});
+    ASSERT_EQ(reopened_sstable.GetEntryCount(), max_key);
+    ASSERT_EQ(reopened_sstable.GetBlockCount(), sstable.GetBlockCount());
+    // 每个block只有一项索引,常驻内存远小于每个entry 16字节
+    size_t full_index_size = max_key * sizeof(uint64_t) * 2;
+    printf("The sparse index usage is %zu, the full index usage is %zu\n",
+           reopened_sstable.GetIndexMemoryUsage(), full_index_size);
+    ASSERT_LT(reopened_sstable.GetIndexMemoryUsage() * 50, full_index_size);
+
+    std::string value;
+    for (uint64_t key = 0; key < max_key * 3; ++key) {
+        if (key % 3 == 0) {
+            ASSERT_TRUE(reopened_sstable.Get(key, &value, true));
+            ASSERT_EQ(value, std::to_string(key / 3));
+        } else {
+            ASSERT_FALSE(reopened_sstable.Get(key, &value, false));
+        }
+    }
+    size_t entry_cnt = 0;
+    uint64_t prev_key = 0;
+    for (size_t blockno = 0; blockno < reopened_sstable.GetBlockCount(); ++blockno) {
+        std::string block;
+        ASSERT_TRUE(reopened_sstable.LoadBlock(blockno, &block));
+        BlockReader reader((Slice(block)));
+        ASSERT_TRUE(reader.Valid());
+        for (size_t i = 0; i < reader.GetEntryCount(); ++i, ++entry_cnt) {
+            ASSERT_TRUE(entry_cnt == 0 || reader.KeyAt(i) > prev_key);
+            prev_key = reader.KeyAt(i);
+            ASSERT_EQ(reader.ValueAt(i).ToString(), std::to_string(prev_key / 3));
+        }
+    }
+    ASSERT_EQ(entry_cnt, max_key);
+}
+
+TEST(SSTABLE_TEST, COMPACT_FORMAT_TEST) {
+    const uint64_t max_key = 100000;
+    SSTable::KvContainer sklist;
+    for (uint64_t key = 0; key < max_key; ++key) {      // 连续的id和很短的value,key和offset是文件的主要部分
+        sklist.Put(key, std::to_string(key % 1000));
+    }
+    SSTableOptions raw_options, compact_options;
+    compact_options.format_ = kCompactFormat;
+    {
+        SSTable raw_sstable(sklist, SSTableId{7, "sstable_raw_format_test.sst"}, raw_options);
+        SSTable compact_sstable(sklist, SSTableId{8, "sstable_compact_format_test.sst"}, compact_options);
+        ASSERT_EQ(raw_sstable.GetFormat(), kRawFormat);
+        ASSERT_EQ(compact_sstable.GetFormat(), kCompactFormat);
+    }
+    struct stat raw_stat{}, compact_stat{};
+    ASSERT_EQ(::stat("sstable_raw_format_test.sst", &raw_stat), 0);
+    ASSERT_EQ(::stat("sstable_compact_format_test.sst", &compact_stat), 0);
+    printf("The raw table size is %ld, the compact table size is %ld\n",
+           static_cast<long>(raw_stat.st_size), static_cast<long>(compact_stat.st_size));
+    ASSERT_LT(compact_stat.st_size * 3, raw_stat.st_size);
+
+    // 读取时使用footer中记录的格式
+    SSTable compact_sstable(SSTableId{8, "sstable_compact_format_test.sst"});
+    SSTableOptions mmap_options;
+    mmap_options.use_mmap_ = true;
+    SSTable mmap_sstable(SSTableId{8, "sstable_compact_format_test.sst"}, mmap_options);
+    SSTable raw_sstable(SSTableId{7, "sstable_raw_format_test.sst"});
+    ASSERT_EQ(compact_sstable.GetFormat(), kCompactFormat);
+    ASSERT_EQ(compact_sstable.GetEntryCount(), max_key);
+    ASSERT_LT(compact_sstable.GetBlockCount(), raw_sstable.GetBlockCount());
+    std::string value;
+    Slice slice;
+    for (uint64_t key = 0; key < max_key + 10; ++key) {
+        bool exist = key < max_key;
+        ASSERT_EQ(compact_sstable.Get(key, &value, true), exist);
+        ASSERT_EQ(mmap_sstable.Get(key, &slice), exist);
+        if (exist) {
+            ASSERT_EQ(value, std::to_string(key % 1000));
+            ASSERT_EQ(slice.ToString(), value);
+        }
+    }
+}
+
+TEST(SSTABLE_TEST, STREAMING_BUILDER_TEST) {
+    const uint64_t max_key = 200000;
+    const std::string path = "sstable_builder_test.sst";
+    for (SyncPolicy policy : {kNoSync, kSyncOnFinish, kSyncOnFlush}) {
+        SSTableOptions options;
+        options.write_buffer_size_ = 10000;        // 向上对齐到block大小,会写很多次
+        options.sync_policy_ = policy;
+        options.format_ = policy == kSyncOnFlush ? kCompactFormat : kRawFormat;
+        SSTableBuilder builder(path, options);
+        ASSERT_TRUE(builder.Ok());
+        for (uint64_t key = 0; key < max_key; ++key) {
+            ASSERT_TRUE(builder.Add(key, TestValue(key)));
+        }
+        ASSERT_TRUE(builder.Finish());
+        ASSERT_FALSE(builder.Add(max_key, TestValue(max_key)));
+        struct stat file_stat{};
+        ASSERT_EQ(::stat(path.c_str(), &file_stat), 0);
+        ASSERT_EQ(static_cast<uint64_t>(file_stat.st_size), builder.GetFileSize());
+
+        SSTable sstable(SSTableId{9, path});
+        ASSERT_EQ(sstable.GetEntryCount(), max_key);
+        ASSERT_EQ(sstable.GetFormat(), options.format_);
+        std::string value;
+        for (uint64_t key = 0; key < max_key; key += 13) {
+            ASSERT_TRUE(sstable.Get(key, &value, true));
+            ASSERT_EQ(value, TestValue(key));
+        }
+        ASSERT_FALSE(sstable.Get(max_key, &value, true));
+    }
+    {       // 没有Finish的文件会被删除
+        SSTableBuilder builder("sstable_abandon_test.sst", SSTableOptions());
+        ASSERT_TRUE(builder.Add(1, "value"));
+    }
+    struct stat file_stat{};
+    ASSERT_NE(::stat("sstable_abandon_test.sst", &file_stat), 0);
+    SSTableBuilder bad_builder("no_such_dir/sstable.sst", SSTableOptions());
+    ASSERT_FALSE(bad_builder.Ok());
+    ASSERT_FALSE(bad_builder.Add(1, "value"));
+    ASSERT_FALSE(bad_builder.Finish());
+}
+
+TEST(SSTABLE_TEST, COMPRESSION_TEST) {
+    const uint64_t max_key = 50000;
+    SSTable::KvContainer sklist;
+    for (uint64_t key = 0; key < max_key; ++key) {
+        sklist.Put(key, JsonValue(key));
+    }
+    sklist.Put(max_key, std::string(1000, 'z'));        // 不同的block压缩效果不同
+    SSTableOptions options;
+    size_t raw_size = 0;
+    for (CompressionType type : {kNoCompression, kLZCompression, kZlibCompression}) {
+        if (!IsCompressionSupported(type)) {
+            continue;
+        }
+        options.compression_ = type;
+        std::string path = "sstable_compression_test_" + std::to_string(type) + ".sst";
+        uint64_t file_size;
+        {
+            SSTableBuilder builder(path, options);
+            SSTable::KvIterator iterator(sklist);
+            iterator.Init();
+            while (iterator.HasNext()) {
+                auto node = iterator.Next();
+                ASSERT_TRUE(builder.Add(node->key_, node->value_));
+            }
+            ASSERT_TRUE(builder.Finish());
+            file_size = builder.GetFileSize();
+            if (type == kNoCompression) {
+                raw_size = file_size;
+                ASSERT_EQ(builder.GetCompressedBlockCount(), 0);
+            } else {
+                ASSERT_GT(builder.GetCompressedBlockCount(), builder.GetBlockCount() / 2);
+            }
+        }
+        printf("Compression type %d table size is %lu\n", type, static_cast<unsigned long>(file_size));
+        if (type != kNoCompression) {
+            ASSERT_LT(file_size * 2, raw_size);
+        }
+
+        BlockCache cache(64 * 1024 * 1024);
+        SSTableOptions read_options;
+        read_options.block_cache_ = &cache;
+        SSTable sstable(SSTableId{10u + type, path}, read_options);
+        read_options.use_mmap_ = true;
+        SSTable mmap_sstable(SSTableId{20u + type, path}, read_options);
+        std::string value;
+        Slice slice;
+        BlockCache::Block holder;
+        size_t zero_copy_cnt = 0;
+        for (uint64_t key = 0; key <= max_key; ++key) {
+            std::string expect = key == max_key ? std::string(1000, 'z') : JsonValue(key);
+            ASSERT_TRUE(sstable.Get(key, &value, true));
+            ASSERT_EQ(value, expect);
+            ASSERT_TRUE(mmap_sstable.Get(key, &value, true));
+            ASSERT_EQ(value, expect);
+            // 没有holder时只能零拷贝地读取没有压缩的block
+            if (mmap_sstable.Get(key, &slice)) {
+                ASSERT_EQ(slice.ToString(), expect);
+                ++zero_copy_cnt;
+            }
+            ASSERT_TRUE(mmap_sstable.Get(key, &slice, &holder));
+            ASSERT_EQ(slice.ToString(), expect);
+            ASSERT_TRUE(sstable.Get(key, &slice, &holder));
+            ASSERT_EQ(slice.ToString(), expect);
+        }
+        if (type == kNoCompression) {
+            ASSERT_EQ(zero_copy_cnt, max_key + 1);
+        } else {
+            ASSERT_LT(zero_copy_cnt, max_key / 2);
+        }
+        ASSERT_FALSE(sstable.Get(max_key + 1, &value, true));
+        // block cache中保存的是解压之后的block
+        std::string block;
+        ASSERT_TRUE(sstable.LoadBlock(0, &block));
+        BlockReader reader((Slice(block)));
+        ASSERT_TRUE(reader.Valid());
+        ASSERT_EQ(reader.ValueAt(0).ToString(), JsonValue(0));
+        ASSERT_GE(cache.GetUsage(), raw_size / 2);
+    }
+}
+
+TEST(SSTABLE_TEST, INDEX_LAYOUT_TEST) {
+    const uint64_t max_key = 100000;
+    {
+        SSTable::KvContainer sklist;
+        for (uint64_t key = 0; key < max_key; ++key) {
+            sklist.Put(key * 2, std::to_string(key));
+        }
+        SSTable sstable(sklist, SSTableId{30, "sstable_index_layout_test.sst"});
+    }
+    std::string value;
+    for (SearchLayout layout : {kSortedLayout, kEytzingerLayout, kBTreeLayout, kAutoLayout}) {
+        SSTableOptions options;
+        options.index_layout_ = layout;
+        SSTable sstable(SSTableId{30, "sstable_index_layout_test.sst"}, options);
+        for (uint64_t key = 0; key < max_key * 2 + 2; ++key) {
+            ASSERT_EQ(sstable.Get(key, &value, true), key % 2 == 0 && key < max_key * 2);
+            if (key % 2 == 0 && key < max_key * 2) {
+                ASSERT_EQ(value, std::to_string(key / 2));
+            }
+        }
+    }
+}
+
+TEST(SSTABLE_TEST, LEARNED_INDEX_TEST) {
+    const uint64_t max_key = 100000;
+    SSTable::KvContainer sklist;
+    for (uint64_t key = 0; key < max_key; ++key) {
+        sklist.Put(key * 2, std::to_string(key));
+    }
+    for (BlockFormat format : {kRawFormat, kCompactFormat}) {
+        SSTableOptions options;
+        options.format_ = format;
+        options.learned_index_error_ = 4;
+        SSTableId id{31, "sstable_learned_index_test.sst"};
+        size_t block_cnt;
+        {
+            SSTable sstable(sklist, id, options);
+            block_cnt = sstable.GetBlockCount();
+            ASSERT_GT(block_cnt, 100);
+            // 定长的value,每个block的最后一个key几乎是线性的
+            ASSERT_GT(sstable.GetLearnedSegmentCount(), 0);
+            ASSERT_LT(sstable.GetLearnedSegmentCount(), block_cnt / 10);
+        }
+        for (bool use_mmap : {false, true}) {
+            SSTableOptions read_options;
+            read_options.use_mmap_ = use_mmap;
+            SSTable sstable(id, read_options);
+            ASSERT_EQ(sstable.GetBlockCount(), block_cnt);
+            ASSERT_GT(sstable.GetLearnedSegmentCount(), 0);
+            std::string value;
+            for (uint64_t key = 0; key < max_key * 2 + 2; ++key) {
+                ASSERT_EQ(sstable.Get(key, &value, true), key % 2 == 0 && key < max_key * 2);
+                if (key % 2 == 0 && key < max_key * 2) {
+                    ASSERT_EQ(value, std::to_string(key / 2));
+                }
+            }
+        }
+    }
+    // 没有learned index的文件照常读取
+    SSTable plain(sklist, SSTableId{31, "sstable_learned_index_test.sst"});
+    ASSERT_EQ(plain.GetLearnedSegmentCount(), 0);
+    std::string value;
+    ASSERT_TRUE(plain.Get(max_key, &value, true));
+    ASSERT_EQ(value, std::to_string(max_key / 2));
+}
+
+TEST(SSTABLE_TEST, CHECKSUM_TEST) {
+    const uint64_t max_key = 10000;
+    const std::string path = "sstable_checksum_test.sst";
+    SSTable::KvContainer sklist;
+    FillSkipList(&sklist, max_key, 1);
+    uint64_t file_size;
+    {
+        SSTable sstable(sklist, SSTableId{32, path});
+        ASSERT_GT(sstable.GetBlockCount(), 2);
+        struct stat file_stat{};
+        ASSERT_EQ(stat(path.c_str(), &file_stat), 0);
+        file_size = file_stat.st_size;
+    }
+    // 第一个block从文件开头开始,损坏之后其中的key都读取失败,其他block不受影响
+    CorruptByte(path, kBlockHeaderSize + 10);
+    std::string value;
+    for (VerifyPolicy policy : {kVerifyOnFill, kVerifyAlways}) {
+        for (bool use_mmap : {false, true}) {
+            BlockCache cache(1024 * 1024);
+            SSTableOptions options = CacheOptions(&cache);
+            options.use_mmap_ = use_mmap;
+            options.verify_policy_ = policy;
+            SSTable sstable(SSTableId{32, path}, options);
+            ASSERT_EQ(sstable.GetEntryCount(), max_key);
+            ASSERT_FALSE(sstable.Get(0, &value, true));
+            ASSERT_FALSE(sstable.LoadBlock(0, &value));
+            ASSERT_TRUE(sstable.Get(max_key - 1, &value, true));
+            ASSERT_EQ(value, TestValue(max_key - 1));
+        }
+    }
+    // 默认的kVerifyOnFill下mmap零拷贝读取在第一次访问block时校验,校验失败的block每次都读取失败
+    {
+        SSTableOptions options;
+        options.use_mmap_ = true;
+        SSTable sstable(SSTableId{32, path}, options);
+        ASSERT_TRUE(sstable.IsMapped());
+        Slice slice;
+        for (int i = 0; i < 2; ++i) {
+            ASSERT_FALSE(sstable.Get(0, &slice));
+            ASSERT_FALSE(sstable.Get(1, &slice));
+            ASSERT_TRUE(sstable.Get(max_key - 1, &slice));
+            ASSERT_EQ(slice.ToString(), TestValue(max_key - 1));
+        }
+    }
+    SSTableOptions no_verify;
+    no_verify.verify_policy_ = kNoVerify;
+    ASSERT_TRUE(SSTable(SSTableId{32, path}, no_verify).LoadBlock(0, &value));
+    // index紧挨着footer,损坏之后整个表不可用
+    CorruptByte(path, file_size - Footer::kEncodedSize - 1);
+    for (bool use_mmap : {false, true}) {
+        SSTableOptions options;
+        options.use_mmap_ = use_mmap;
+        ASSERT_EQ(SSTable(SSTableId{32, path}, options).GetEntryCount(), 0);
+    }
+    CorruptByte(path, file_size - Footer::kEncodedSize - 1);
+    ASSERT_EQ(SSTable(SSTableId{32, path}).GetEntryCount(), max_key);
+    // 不校验时损坏的index中超出data block区域的handle被拒绝,而不是按照其中的大小读取
+    uint64_t index_offset = SSTable(SSTableId{32, path}).GetProperties().footer_.index_offset_;
+    CorruptByte(path, index_offset + sizeof(uint64_t) * 2 + 5);     // 第一个block的大小增加到几百TB
+    for (bool use_mmap : {false, true}) {
+        SSTableOptions options = no_verify;
+        options.use_mmap_ = use_mmap;
+        SSTable sstable(SSTableId{32, path}, options);
+        ASSERT_EQ(sstable.GetEntryCount(), max_key);
+        ASSERT_FALSE(sstable.LoadBlock(0, &value));
+        ASSERT_FALSE(sstable.Get(0, &value, true));
+        ASSERT_TRUE(sstable.Get(max_key - 1, &value, true));
+    }
+    CorruptByte(path, index_offset + sizeof(uint64_t) * 2 + 5);
+    // footer的校验和即使在kNoVerify下也会检查
+    CorruptByte(path, file_size - Footer::kEncodedSize + 1);
+    ASSERT_EQ(SSTable(SSTableId{32, path}, no_verify).GetEntryCount(), 0);
+}
+
+// 只输出耗时,正确性由CRC32C_TEST和CHECKSUM_TEST检查,需要时用--gtest_also_run_disabled_tests运行
+TEST(SSTABLE_TEST, DISABLED_CHECKSUM_BENCH) {
+    const uint64_t max_key = 100000;
+    const std::string path = "sstable_checksum_bench.sst";
+    {
+        SSTable::KvContainer sklist;
+        FillSkipList(&sklist, max_key, 1);
+        SSTableOptions options;
+        options.compression_ = kLZCompression;
+        SSTable sstable(sklist, SSTableId{33, path}, options);
+    }
+    std::vector<uint64_t> keys(max_key);
+    std::mt19937_64 rng(19);
+    for (auto &key : keys) {
+        key = rng() % max_key;
+    }
+    std::string block(4096, 'x');
+    uint32_t crc_sum = 0;
+    double hardware_cost, portable_cost;
+    {
+        testutils::TimeCounter counter(hardware_cost);
+        for (int i = 0; i < 100000; ++i) {
+            crc_sum += Crc32c(block.data(), block.size());
+        }
+    }
+    {
+        testutils::TimeCounter counter(portable_cost);
+        for (int i = 0; i < 100000; ++i) {
+            crc_sum += PortableExtendCrc32c(0, block.data(), block.size());
+        }
+    }
+    printf("The crc32c cost of 100000 blocks is %lf, the portable cost is %lf (%u)\n",
+           hardware_cost, portable_cost, crc_sum);
+    // 压缩过的block在mmap模式下也要解压,和pread一样在读进内存时校验
+    const char *modes[] = {"pread", "cached pread", "mmap"};
+    for (int mode = 0; mode < 3; ++mode) {
+        BlockCache cache(64 * 1024 * 1024);
+        std::unique_ptr<SSTable> tables[2];
+        for (int i = 0; i < 2; ++i) {
+            SSTableOptions options = CacheOptions(mode == 1 ? &cache : nullptr);
+            options.use_mmap_ = mode == 2;
+            options.verify_policy_ = i == 0 ? kNoVerify : kVerifyOnFill;
+            tables[i].reset(new SSTable(SSTableId{33u + i, path}, options));
+        }
+        std::string value;
+        for (uint64_t key = 0; key < max_key; ++key) {      // 预热page cache和block cache
+            ASSERT_TRUE(tables[0]->Get(key, &value, true));
+            ASSERT_TRUE(tables[1]->Get(key, &value, true));
+        }
+        // 交替测量几轮取最小值,减少其他负载的干扰
+        double costs[2] = {1e9, 1e9};
+        for (int round = 0; round < 3; ++round) {
+            for (int i = 0; i < 2; ++i) {
+                double cost;
+                {
+                    testutils::TimeCounter counter(cost);
+                    for (auto key : keys) {
+                        tables[i]->Get(key, &value, true);
+                    }
+                }
+                costs[i] = std::min(costs[i], cost);
+            }
+        }
+        printf("The %s get cost without verify is %lf, with verify is %lf, overhead %.1lf%%\n",
+               modes[mode], costs[0], costs[1], (costs[1] - costs[0]) / costs[0] * 100);
+    }
+}
+
+TEST(SSTABLE_TEST, ITERATOR_TEST) {
+    const uint64_t max_key = 20000;
+    SSTable::KvContainer sklist;
+    FillSkipList(&sklist, max_key, 3);
+    for (BlockFormat format : {kRawFormat, kCompactFormat}) {
+        SSTableOptions options;
+        options.format_ = format;
+        options.compression_ = kLZCompression;
+        auto sstable = std::make_shared<SSTable>(sklist, SSTableId{34, "sstable_iterator_test.sst"}, options);
+        ASSERT_EQ(sstable->GetSmallestKey(), 0);
+        ASSERT_EQ(sstable->GetLargestKey(), (max_key - 1) / 3 * 3);
+        auto iter = sstable->NewIterator();
+        uint64_t expect = 0;
+        for (iter->SeekToFirst(); iter->Valid(); iter->Next(), expect += 3) {
+            ASSERT_EQ(iter->Key(), expect);
+            ASSERT_EQ(iter->Value().ToString(), TestValue(expect));
+        }
+        ASSERT_EQ(expect, (max_key + 2) / 3 * 3);
+        for (uint64_t key : {0, 1, 3, 4000, 4001, 19998, 19999}) {
+            iter->Seek(key);
+            uint64_t next = (key + 2) / 3 * 3;
+            ASSERT_EQ(iter->Valid(), next < max_key);
+            if (iter->Valid()) {
+                ASSERT_EQ(iter->Key(), next);
+            }
+        }
+        // 两个不重叠的表依次遍历
+        SSTable::KvContainer tail;
+        tail.Put(max_key, "tail");
+        auto tail_table = std::make_shared<SSTable>(tail, SSTableId{35, "sstable_iterator_tail.sst"}, options);
+        auto level_iter = NewLevelIterator({sstable, tail_table});
+        level_iter->Seek(max_key - 1);
+        ASSERT_TRUE(level_iter->Valid());
+        ASSERT_EQ(level_iter->Key(), max_key);
+        ASSERT_EQ(level_iter->Value().ToString(), "tail");
+        level_iter->Next();
+        ASSERT_FALSE(level_iter->Valid());
+        ASSERT_TRUE(level_iter->Ok());
+    }
+}
+
+TEST(SSTABLE_TEST, LAZY_OPEN_TEST) {
+    const uint64_t max_key = 20000;
+    const size_t table_cnt = 4;
+    std::vector<SSTableId> ids;
+    std::vector<TableProperties> properties;
+    for (size_t i = 0; i < table_cnt; ++i) {
+        SSTable::KvContainer sklist;
+        for (uint64_t key = i * max_key; key < (i + 1) * max_key; key += 2) {
+            sklist.Put(key, TestValue(key));
+        }
+        ids.push_back(SSTableId{36 + i, "sstable_lazy_open_test_" + std::to_string(i) + ".sst"});
+        SSTable sstable(sklist, ids.back());
+        properties.push_back(sstable.GetProperties());
+    }
+    for (bool use_mmap : {false, true}) {
+        SSTableOptions options;
+        options.use_mmap_ = use_mmap;
+        // 只能容纳一个表的索引
+        SSTable probe(ids[0], options);
+        size_t charge = sizeof(TableIndex) + probe.GetIndexMemoryUsage() + (use_mmap ? 0 : probe.GetFilterSize());
+        IndexCache cache(charge * 3 / 2, 0);
+        options.index_cache_ = &cache;
+        std::vector<std::unique_ptr<SSTable>> tables;
+        for (size_t i = 0; i < table_cnt; ++i) {
+            tables.emplace_back(new SSTable(ids[i], properties[i], options));
+            // key范围和entry数量来自manifest,不需要加载索引
+            ASSERT_EQ(tables[i]->GetSmallestKey(), i * max_key);
+            ASSERT_EQ(tables[i]->GetLargestKey(), (i + 1) * max_key - 2);
+            ASSERT_EQ(tables[i]->GetEntryCount(), max_key / 2);
+            ASSERT_FALSE(tables[i]->Get((i + 1) * max_key, nullptr, false));
+            ASSERT_FALSE(tables[i]->IsIndexLoaded());
+        }
+        ASSERT_EQ(cache.GetUsage(), 0);
+        // 第一个表的迭代器一直持有它的索引,之后被淘汰也不影响遍历
+        auto iter = tables[0]->NewIterator();
+        iter->SeekToFirst();
+        std::string value;
+        for (size_t i = 0; i < table_cnt; ++i) {
+            for (uint64_t key = i * max_key; key < (i + 1) * max_key; ++key) {
+                ASSERT_EQ(tables[i]->Get(key, &value, true), key % 2 == 0);
+                if (key % 2 == 0) {
+                    ASSERT_EQ(value, TestValue(key));
+                }
+            }
+            ASSERT_TRUE(tables[i]->IsIndexLoaded());
+            ASSERT_EQ(cache.GetEntryCount(), 1);
+            ASSERT_LE(cache.GetUsage(), cache.GetCapacity());
+        }
+        ASSERT_FALSE(tables[0]->IsIndexLoaded());
+        uint64_t expect = 0;
+        for (; iter->Valid(); iter->Next(), expect += 2) {
+            ASSERT_EQ(iter->Key(), expect);
+        }
+        ASSERT_EQ(expect, max_key);
+        ASSERT_TRUE(iter->Ok());
+        // 被淘汰之后重新加载
+        ASSERT_TRUE(tables[0]->Get(0, &value, true));
+        ASSERT_TRUE(tables[0]->IsIndexLoaded());
+        ASSERT_FALSE(tables[table_cnt - 1]->IsIndexLoaded());
+        tables.clear();
+        ASSERT_EQ(cache.GetUsage(), 0);
+    }
+    // 文件和manifest中记录的大小不一致时当作空表
+    auto truncated = properties[0];
+    truncated.file_size_ += 1;
+    SSTable sstable(ids[0], truncated);
+    ASSERT_EQ(sstable.GetEntryCount(), 0);
+    std::string value;
+    ASSERT_FALSE(sstable.Get(0, &value, true));
+}
+
+TEST(DISK_STORAGE_TEST, APPEND_TEST) {
+    const std::string path = "disk_storage_test.dat";
+    std::string expect;
+    std::mt19937_64 rng(37);
+    for (bool direct_io : {false, true}) {
+        FileOptions options;
+        options.direct_io_ = direct_io;
+        options.buffer_size_ = 3 * 1024;        // 向上对齐到一块,追加的数据跨越很多次缓冲区写入
+        DiskStorage file;
+        ASSERT_TRUE(file.OpenForWrite(path, true, options));
+        printf("direct io requested %d, enabled %d\n", direct_io, file.IsDirectIO());
+        expect.clear();
+        for (int i = 0; i < 100; ++i) {
+            std::string data(rng() % 3000, static_cast<char>('a' + i % 26));
+            ASSERT_TRUE(file.Append(data));
+            expect += data;
+            ASSERT_EQ(file.GetAppendOffset(), expect.size());
+        }
+        ASSERT_LE(file.Size(), expect.size());
+        ASSERT_TRUE(file.Sync());       // 末尾不足一块的部分也写入了
+        ASSERT_FALSE(file.IsDirectIO() && expect.size() % DiskStorage::kAlignment != 0);
+        ASSERT_EQ(file.Size(), expect.size());
+        std::string actual(expect.size(), '\0');
+        ASSERT_TRUE(file.ReadAt(0, actual.size(), &actual[0]));
+        ASSERT_EQ(actual, expect);
+        ASSERT_FALSE(file.ReadAt(expect.size() - 1, 2, &actual[0]));
+        ASSERT_TRUE(file.Close());
+    }
+    // 不截断时追加到文件末尾,WriteAt原地覆盖
+    DiskStorage file;
+    ASSERT_TRUE(file.OpenForWrite(path, false));
+    ASSERT_EQ(file.GetAppendOffset(), expect.size());
+    ASSERT_TRUE(file.Append("tail"));
+    ASSERT_TRUE(file.Flush());
+    ASSERT_TRUE(file.WriteAt(1, "XY", 2));
+    expect += "tail";
+    expect.replace(1, 2, "XY");
+    DiskStorage reader;
+    ASSERT_TRUE(reader.OpenForRead(path, FileOptions()));
+    reader.Advise(kSequentialAccess);
+    reader.Readahead(0, expect.size());
+    std::string actual(expect.size(), '\0');
+    ASSERT_TRUE(reader.ReadAt(0, actual.size(), &actual[0]));
+    ASSERT_EQ(actual, expect);
+    reader.DropCache(0, 0);
+    ASSERT_FALSE(DiskStorage().OpenForRead("disk_storage_test_missing.dat"));
+}
+
+TEST(SSTABLE_TEST, DIRECT_IO_TEST) {
+    const uint64_t max_key = 50000;
+    SSTable::KvContainer sklist;
+    FillSkipList(&sklist, max_key, 1);
+    double costs[2];
+    for (bool direct_io : {false, true}) {
+        SSTableOptions options;
+        options.direct_io_ = direct_io;
+        options.write_buffer_size_ = 64 * 1024 + 100;
+        std::string path = "sstable_direct_io_test_" + std::to_string(direct_io) + ".sst";
+        {
+            testutils::TimeCounter counter(costs[direct_io]);
+            SSTable built(sklist, SSTableId{40u + direct_io, path}, options);
+            ASSERT_EQ(built.GetEntryCount(), max_key);
+        }
+        // 迭代器按非mmap模式读取并预读后面的block
+        auto sstable = std::make_shared<SSTable>(SSTableId{40u + direct_io, path});
+        ASSERT_EQ(sstable->GetEntryCount(), max_key);
+        auto iter = sstable->NewIterator(false);
+        uint64_t expect = 0;
+        for (iter->SeekToFirst(); iter->Valid(); iter->Next(), ++expect) {
+            ASSERT_EQ(iter->Key(), expect);
+            ASSERT_EQ(iter->Value().ToString(), TestValue(expect));
+        }
+        ASSERT_EQ(expect, max_key);
+        ASSERT_TRUE(iter->Ok());
+    }
+    printf("The build cost is %lf with page cache, %lf with direct io\n", costs[0], costs[1]);
+}
+
+int main(int argc, char* argv[]) {
+    testing::InitGoogleTest(&argc, argv);
+    RUN_ALL_TESTS();
+    return 0;
+}